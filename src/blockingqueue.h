@@ -0,0 +1,65 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+template<typename T>
+class BlockingQueue
+{
+private:
+	std::deque<T> queue;
+	size_t capacity;
+	bool closed = false;
+	mutable std::mutex mutex;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+
+public:
+	//a capacity of 0 means the queue is unbounded
+	explicit BlockingQueue(size_t capacityI = 0): capacity(capacityI)
+	{
+	}
+
+	//blocks while the queue is full, returns false if the queue was closed
+	bool push(T item)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		notFull.wait(lock, [this]{return closed || capacity == 0 || queue.size() < capacity;});
+		if(closed)
+			return false;
+		queue.push_back(std::move(item));
+		lock.unlock();
+		notEmpty.notify_one();
+		return true;
+	}
+
+	//blocks while the queue is empty, returns false once the queue is closed and drained
+	bool pop(T& item)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		notEmpty.wait(lock, [this]{return closed || !queue.empty();});
+		if(queue.empty())
+			return false;
+		item = std::move(queue.front());
+		queue.pop_front();
+		lock.unlock();
+		notFull.notify_one();
+		return true;
+	}
+
+	void close()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		closed = true;
+		lock.unlock();
+		notEmpty.notify_all();
+		notFull.notify_all();
+	}
+
+	size_t size() const
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		return queue.size();
+	}
+};
@@ -26,6 +26,7 @@ Circut::Circut(const Circut& in)
 	nets = in.nets;
 	dirHint = in.dirHint;
 	pagenum = in.pagenum;
+	prob = in.prob;
 
 	elements.resize(in.elements.size(), nullptr);
 	for(size_t i = 0; i < elements.size(); ++i)
@@ -42,6 +43,11 @@ image(imageI), prob(probI), rect(rectI), pagenum(pagenumI)
 {
 }
 
+Circut::Circut(const std::string& modelI, float probI, cv::Rect rectI, size_t pagenumI, DirectionHint hint):
+model(modelI), rect(rectI), pagenum(pagenumI), prob(probI), dirHint(hint)
+{
+}
+
 cv::Mat Circut::plainCircutImage() const
 {
 	return image;
@@ -55,7 +61,11 @@ cv::Rect Circut::getRect() const
 cv::Mat Circut::ciructImage() const
 {
 	cv::Mat visulization;
-	image.copyTo(visulization);
+	//annotations are drawn in color even on grayscale circuts
+	if(image.channels() == 1)
+		cv::cvtColor(image, visulization, cv::COLOR_GRAY2BGR);
+	else
+		image.copyTo(visulization);
 	for(size_t i = 0; i < elements.size(); ++i)
 	{
 		auto padding = getRectXYPaddingPercents(C_DIRECTION_UNKOWN, 1);
@@ -751,6 +761,9 @@ std::vector<Net*> Circut::healOverconnectedElement(Element* element, std::vector
 
 std::string Circut::getString()
 {
+	if(!model.empty())
+		return model;
+
 	if(nets.size() < 2)
 	{
 		Log(Log::WARN)<<"Can't generate string for circut without at least two nets";
@@ -763,9 +776,6 @@ std::string Circut::getString()
 		return "";
 	}
 
-	if(!model.empty())
-		return model;
-
 	uint64_t startingNetId = getStartingNetId(dirHint);
 	uint64_t endingNetId = getEndingNetId(dirHint, startingNetId);
 
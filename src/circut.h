@@ -47,6 +47,8 @@ public:
 	Circut() = default;
 	Circut(const Circut& in);
 	Circut(cv::Mat image, float prob, cv::Rect rect, size_t pagenum = 0);
+	//restores an already parsed circut without image, elements or nets
+	Circut(const std::string& model, float prob, cv::Rect rect, size_t pagenum, DirectionHint hint);
 	Circut operator=(const Circut& in);
 	~Circut();
 	cv::Mat ciructImage() const;
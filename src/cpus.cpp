@@ -0,0 +1,81 @@
+#include "cpus.h"
+
+#include <sched.h>
+#include <thread>
+#include <fstream>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include "log.h"
+
+size_t affinityCpus()
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if(sched_getaffinity(0, sizeof(set), &set) != 0)
+		return 0;
+	return CPU_COUNT(&set);
+}
+
+static size_t cpusFromQuota(double quota, double period)
+{
+	if(quota <= 0 || period <= 0)
+		return 0;
+	return std::max<size_t>(1, std::ceil(quota/period));
+}
+
+size_t cgroupCpus()
+{
+	//cgroup v2
+	std::ifstream cpuMax("/sys/fs/cgroup/cpu.max");
+	if(cpuMax.is_open())
+	{
+		std::string quota;
+		double period = 0;
+		cpuMax>>quota>>period;
+		if(cpuMax.fail() || quota == "max")
+			return 0;
+		try
+		{
+			return cpusFromQuota(std::stod(quota), period);
+		}
+		catch(const std::logic_error& ex)
+		{
+			Log(Log::DEBUG)<<"Could not parse /sys/fs/cgroup/cpu.max";
+			return 0;
+		}
+	}
+
+	//cgroup v1
+	for(const char* dir : {"/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct"})
+	{
+		std::ifstream quotaFile(std::string(dir) + "/cpu.cfs_quota_us");
+		std::ifstream periodFile(std::string(dir) + "/cpu.cfs_period_us");
+		if(!quotaFile.is_open() || !periodFile.is_open())
+			continue;
+		double quota = -1;
+		double period = 0;
+		quotaFile>>quota;
+		periodFile>>period;
+		return cpusFromQuota(quota, period);
+	}
+
+	return 0;
+}
+
+size_t availableCpus()
+{
+	size_t cpus = std::thread::hardware_concurrency();
+	size_t affinity = affinityCpus();
+	size_t cgroup = cgroupCpus();
+
+	if(affinity > 0 && (cpus == 0 || affinity < cpus))
+		cpus = affinity;
+	if(cgroup > 0 && (cpus == 0 || cgroup < cpus))
+		cpus = cgroup;
+	if(cpus == 0)
+		cpus = 1;
+	return cpus;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+
+//number of cpus this process may run on according to its affinity mask, 0 if unkown
+size_t affinityCpus();
+
+//cpu limit imposed by the cgroup cpu quota rounded up, 0 if there is no quota
+size_t cgroupCpus();
+
+//number of threads that can run in parallel taking hardware concurrency, affinity and cgroup quota into account
+size_t availableCpus();
@@ -0,0 +1,230 @@
+#include "daemon.h"
+
+#include <map>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "json.h"
+#include "log.h"
+
+Daemon::Connection::~Connection()
+{
+	if(ownsFd)
+		close(fd);
+}
+
+void Daemon::Connection::respond(const std::string& line)
+{
+	std::scoped_lock lock(mutex);
+	std::string buffer = line + '\n';
+	size_t written = 0;
+	while(written < buffer.size())
+	{
+		ssize_t ret = write(fd, buffer.data()+written, buffer.size()-written);
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+		{
+			//the client went away, the document is still recorded in the journal
+			Log(Log::WARN)<<"Could not send response: "<<strerror(errno);
+			return;
+		}
+		written += ret;
+	}
+}
+
+Daemon::Daemon(std::function<void(Job job)> submitJobI, const volatile sig_atomic_t* stopI): submitJob(submitJobI), stop(stopI)
+{
+}
+
+bool Daemon::parseRequest(const std::string& line, std::string& id, std::string& path)
+{
+	size_t start = line.find_first_not_of(" \t\r");
+	if(start == std::string::npos)
+		return false;
+
+	if(line[start] != '{')
+	{
+		size_t end = line.find_last_not_of(" \t\r");
+		path = line.substr(start, end-start+1);
+		return true;
+	}
+
+	std::map<std::string, std::string> values;
+	if(!parseJsonObject(line, values))
+		return false;
+	auto pathIterator = values.find("path");
+	if(pathIterator == values.end() || pathIterator->second.empty())
+		return false;
+	path = pathIterator->second;
+	auto idIterator = values.find("id");
+	if(idIterator != values.end())
+		id = idIterator->second;
+	return true;
+}
+
+std::string Daemon::response(Job& job, bool completed, const std::string& id)
+{
+	std::stringstream ss;
+	ss<<"{\"id\":"<<jsonString(id)<<",\"path\":"<<jsonString(job.path.string())<<",\"status\":";
+	if(!job.document)
+		ss<<"\"failed\"";
+	else if(!completed)
+		ss<<"\"error\"";
+	else
+		ss<<"\"done\"";
+	if(job.document && completed)
+	{
+		ss<<",\"cached\":"<<(job.cached ? "true" : "false")<<",\"result\":";
+		job.document->writeJson(ss);
+	}
+	ss<<'}';
+	return ss.str();
+}
+
+void Daemon::submit(const std::string& line, const std::shared_ptr<Connection>& connection)
+{
+	std::string id;
+	std::string path;
+	if(!parseRequest(line, id, path))
+	{
+		if(line.find_first_not_of(" \t\r") != std::string::npos)
+			connection->respond("{\"status\":\"invalid\",\"request\":" + jsonString(line) + "}");
+		return;
+	}
+
+	Job job;
+	job.path = path;
+	job.index = nextIndex++;
+	//the connection is kept open until every document submitted on it has been answered
+	job.done = [connection, id](Job& job, bool completed)
+	{
+		connection->respond(response(job, completed, id));
+	};
+	Log(Log::INFO)<<"Received document "<<job.path;
+	submitJob(std::move(job));
+}
+
+void Daemon::serve(int inFd, std::shared_ptr<Connection> connection)
+{
+	std::string pending;
+	char buffer[4096];
+	while(!*stop)
+	{
+		ssize_t ret = read(inFd, buffer, sizeof(buffer));
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			break;
+
+		pending.append(buffer, ret);
+		size_t newline;
+		while((newline = pending.find('\n')) != std::string::npos)
+		{
+			submit(pending.substr(0, newline), connection);
+			pending.erase(0, newline+1);
+		}
+	}
+	if(!pending.empty() && !*stop)
+		submit(pending, connection);
+}
+
+bool Daemon::serveStdio(int outFd)
+{
+	Log(Log::INFO)<<"Reading requests from stdin";
+	serve(STDIN_FILENO, std::make_shared<Connection>(outFd, false));
+	return true;
+}
+
+bool Daemon::serveSocket(const std::filesystem::path& path)
+{
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if(path.string().size() >= sizeof(address.sun_path))
+	{
+		Log(Log::ERROR)<<"Socket path "<<path<<" is too long";
+		return false;
+	}
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path)-1);
+
+	int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(listenFd < 0)
+	{
+		Log(Log::ERROR)<<"Could not create socket: "<<strerror(errno);
+		return false;
+	}
+
+	//a socket left behind by a previous instance would make bind fail
+	std::error_code ec;
+	if(std::filesystem::is_socket(path, ec))
+		std::filesystem::remove(path, ec);
+
+	if(bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, 16) < 0)
+	{
+		Log(Log::ERROR)<<"Could not listen on "<<path<<": "<<strerror(errno);
+		close(listenFd);
+		return false;
+	}
+	Log(Log::INFO)<<"Listening on "<<path;
+
+	struct Client
+	{
+		std::shared_ptr<Connection> connection;
+		std::thread thread;
+		std::atomic<bool> finished = false;
+	};
+	std::vector<std::unique_ptr<Client>> clients;
+
+	while(!*stop)
+	{
+		int clientFd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+		if(clientFd < 0)
+		{
+			if(errno == EINTR || errno == ECONNABORTED)
+				continue;
+			Log(Log::ERROR)<<"Could not accept connection: "<<strerror(errno);
+			break;
+		}
+
+		//reap clients that have hung up
+		for(size_t i = 0; i < clients.size();)
+		{
+			if(clients[i]->finished)
+			{
+				clients[i]->thread.join();
+				clients.erase(clients.begin()+i);
+			}
+			else
+			{
+				++i;
+			}
+		}
+
+		std::unique_ptr<Client> client = std::make_unique<Client>();
+		client->connection = std::make_shared<Connection>(clientFd, true);
+		Client* clientPtr = client.get();
+		client->thread = std::thread([this, clientPtr]()
+		{
+			serve(clientPtr->connection->fd, clientPtr->connection);
+			clientPtr->finished = true;
+		});
+		clients.push_back(std::move(client));
+	}
+
+	close(listenFd);
+	std::filesystem::remove(path, ec);
+
+	//unblock readers so that no new requests are accepted, responses are still sent for documents in flight
+	for(std::unique_ptr<Client>& client : clients)
+	{
+		shutdown(client->connection->fd, SHUT_RD);
+		client->thread.join();
+	}
+	return true;
+}
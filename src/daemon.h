@@ -0,0 +1,45 @@
+#pragma once
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <csignal>
+#include <functional>
+#include <filesystem>
+
+#include "pipeline.h"
+
+//keeps the pipeline and its networks alive and accepts documents to process as json lines
+//requests are {"path":"/some/file.pdf","id":"optional id"} or a bare path, one per line
+//every request is answered with one json line once its document leaves the pipeline
+class Daemon
+{
+private:
+	struct Connection
+	{
+		int fd;
+		std::mutex mutex;
+		bool ownsFd;
+
+		Connection(int fdI, bool ownsFdI): fd(fdI), ownsFd(ownsFdI) {}
+		~Connection();
+		void respond(const std::string& line);
+	};
+
+	std::function<void(Job job)> submitJob;
+	const volatile sig_atomic_t* stop;
+	std::atomic<size_t> nextIndex = 0;
+
+private:
+	static bool parseRequest(const std::string& line, std::string& id, std::string& path);
+	static std::string response(Job& job, bool completed, const std::string& id);
+	void serve(int inFd, std::shared_ptr<Connection> connection);
+	void submit(const std::string& line, const std::shared_ptr<Connection>& connection);
+
+public:
+	//submitJobI is expected to push the job into a pipeline whose sink calls Job::done
+	Daemon(std::function<void(Job job)> submitJobI, const volatile sig_atomic_t* stopI);
+	//reads requests from stdin and writes responses to outFd until stdin is closed
+	bool serveStdio(int outFd);
+	//accepts connections on a unix socket until stop is set
+	bool serveSocket(const std::filesystem::path& path);
+};
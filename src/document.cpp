@@ -9,10 +9,15 @@
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 #include <map>
+#include <algorithm>
 
 #include "popplertocv.h"
 #include "linedetection.h"
 #include "tokenize.h"
+#include "utils.h"
+#include "hash.h"
+#include "json.h"
+#include "metrics.h"
 
 std::vector<cv::Mat> getYoloImages(std::vector<cv::Mat> images, Yolo5* yolo,
 								   std::vector<float>* probs, std::vector<cv::Rect>* rects,
@@ -88,7 +93,11 @@ bool Document::saveElementLabels(const std::filesystem::path& folder) const
 			std::to_string(circut.prob) + ".png");
 		try
 		{
-			cv::imwrite(path, circut.plainCircutImage());
+			if(!cv::imwrite(path, circut.plainCircutImage()))
+			{
+				Log(Log::ERROR)<<"Cant write "<<path;
+				return false;
+			}
 
 			std::fstream file;
 			std::filesystem::path labelPath = path;
@@ -101,6 +110,11 @@ bool Document::saveElementLabels(const std::filesystem::path& folder) const
 			}
 			file<<circut.getYoloElementLabels();
 			file.close();
+			if(file.fail())
+			{
+				Log(Log::ERROR)<<"Could not write "<<labelPath;
+				return false;
+			}
 			Log(Log::INFO)<<"Wrote labels to "<<labelPath;
 		}
 		catch(const cv::Exception& ex)
@@ -123,17 +137,24 @@ bool Document::saveCircutLabels(const std::filesystem::path& folder) const
 		}
 	}
 
-	for(size_t i = 0; i < pages.size(); ++i)
+	for(size_t i = 0; i < pageCount(); ++i)
 	{
-		if(circutsOnPage(i) > 0)
+		size_t number = pageSource->pageNumber(i);
+		if(circutsOnPage(number) > 0)
 		{
 			std::filesystem::path path = folder /
 				std::filesystem::path(basename + "_" +
-				std::to_string(i) + ".png");
+				std::to_string(number) + ".png");
 
 			try
 			{
-				cv::imwrite(path, pages[i]);
+				//pages are not kept after detection, only the pages with circuts are rendered again
+				RenderedPage page = renderPage(i);
+				if(page.image.empty() || !cv::imwrite(path, page.image))
+				{
+					Log(Log::ERROR)<<"Cant write "<<path;
+					return false;
+				}
 
 				std::fstream file;
 				std::filesystem::path labelPath = path;
@@ -144,8 +165,13 @@ bool Document::saveCircutLabels(const std::filesystem::path& folder) const
 					Log(Log::ERROR)<<"Could not open file "<<labelPath<<" for writeing";
 					return false;
 				}
-				file<<getYoloCircutLabels(i);
+				file<<getYoloCircutLabels(number, page.image);
 				file.close();
+				if(file.fail())
+				{
+					Log(Log::ERROR)<<"Could not write "<<labelPath;
+					return false;
+				}
 				Log(Log::INFO)<<"Wrote Circut labels to "<<labelPath;
 			}
 			catch(const cv::Exception& ex)
@@ -179,7 +205,11 @@ bool Document::saveCircutImages(const std::filesystem::path& folder) const
 			std::to_string(circut.prob) + ".png");
 		try
 		{
-			cv::imwrite(path, circut.ciructImage());
+			if(!cv::imwrite(path, circut.ciructImage()))
+			{
+				Log(Log::ERROR)<<"Cant write "<<path;
+				return false;
+			}
 			Log(Log::INFO)<<"Wrote image to "<<path;
 		}
 		catch(const cv::Exception& ex)
@@ -220,58 +250,263 @@ bool Document::saveDatafile(const std::filesystem::path& folder)
 		file<<"circut "<<i<<'\n';
 		file<<circuts[i].getSummary()<<'\n';
 	}
+	file.close();
+	if(file.fail())
+	{
+		Log(Log::ERROR)<<"Could not write "<<path;
+		return false;
+	}
 	return true;
 }
 
-bool Document::process(Yolo5* circutYolo, Yolo5* elementYolo, Yolo5* graphYolo)
+size_t Document::pageCount() const
+{
+	return pageSource ? pageSource->count() : 0;
+}
+
+RenderedPage Document::renderPage(size_t index) const
 {
-	std::vector<float> probs;
-	std::vector<cv::Rect> rects;
-	std::vector<size_t> pageNums;
-	if(pages.empty())
+	static Metrics::Histogram& renderLatency = Metrics::global().histogram("render");
+	Metrics::Timer timer(renderLatency);
+	return pageSource->render(index);
+}
+
+std::vector<RenderedPage> Document::pageImages(size_t index) const
+{
+	static Metrics::Histogram& renderLatency = Metrics::global().histogram("render");
+	Metrics::Timer timer(renderLatency);
+	return pageSource->images(index);
+}
+
+void Document::triagePages()
+{
+	static Metrics::Histogram& triageLatency = Metrics::global().histogram("triage");
+	triage.clear();
+	for(size_t i = 0; i < pageCount(); ++i)
+	{
+		Metrics::Timer timer(triageLatency);
+		std::vector<cv::Rect> textBoxes;
+		RenderedPage preview = pageSource->renderPreview(i, TRIAGE_LONG_SIDE, textBoxes);
+		TriageResult result = triagePage(preview.image, textBoxes);
+		Log(Log::EXTRA)<<basename<<" page "<<preview.number<<": "<<TriageResult::verdictName(result.verdict)<<" text "<<result.textCoverage
+			<<" ink "<<result.ink<<" filled "<<result.filled<<" lines "<<result.lines;
+		triage.push_back(result);
+	}
+}
+
+bool Document::pageTriaged(size_t index) const
+{
+	return index < triage.size() && triage[index].skip();
+}
+
+size_t Document::triagedPages() const
+{
+	return std::count_if(triage.begin(), triage.end(), [](const TriageResult& result){return result.skip();});
+}
+
+void Document::setPageText(size_t index, const RenderedPage& page)
+{
+	//text is sized on load if it was requested
+	if(index < text.size())
+		text[index] = page.text;
+}
+
+cv::Mat Document::fullResolutionRegion(const RenderedPage& page, const cv::Mat& crop, cv::Rect& rect) const
+{
+	if(page.scale == 1)
+		return crop;
+
+	static Metrics::Histogram& regionLatency = Metrics::global().histogram("render_region");
+	Metrics::Timer timer(regionLatency);
+	cv::Rect bounds(0, 0, cvRound(page.image.cols*page.scale), cvRound(page.image.rows*page.scale));
+	rect = cv::Rect(std::floor(rect.x*page.scale), std::floor(rect.y*page.scale),
+					std::ceil(rect.width*page.scale), std::ceil(rect.height*page.scale)) & bounds;
+	if(rect.empty())
+		return crop;
+
+	//the region is rendered from the pdf, not upscaled from the detection render
+	RenderedPage region = pageSource->renderRegion(page.number, rect);
+	if(region.image.size() != rect.size())
+	{
+		Log(Log::WARN)<<"Could not render region of page "<<page.number<<", upscaling it instead";
+		cv::Mat upscaled;
+		cv::resize(crop, upscaled, rect.size(), 0, 0, cv::INTER_CUBIC);
+		return upscaled;
+	}
+	//the region may point into its render buffer which is released on return
+	return region.image.clone();
+}
+
+Document::Detections Document::detectCircutRegions(const RenderedPage& page, Yolo5* circutYolo) const
+{
+	static Metrics::Histogram& latency = Metrics::global().histogram("circut_yolo");
+	Metrics::Timer timer(latency);
+	Detections detections;
+	detections.images = getYoloImages({page.image}, circutYolo, &detections.probs, &detections.rects);
+	return detections;
+}
+
+Document::Detections Document::detectGraphRegions(const RenderedPage& page, Yolo5* graphYolo) const
+{
+	static Metrics::Histogram& latency = Metrics::global().histogram("graph_yolo");
+	Metrics::Timer timer(latency);
+	Detections detections;
+	detections.images = getYoloImages({page.image}, graphYolo, &detections.probs, &detections.rects);
+	return detections;
+}
+
+std::vector<Circut> Document::findCircuts(const RenderedPage& page, Detections& detections) const
+{
+	//the circut images are copies so they stay valid after the page is released
+	std::vector<Circut> found;
+	for(size_t i = 0; i < detections.images.size(); ++i)
+	{
+		cv::Mat image = fullResolutionRegion(page, detections.images[i], detections.rects[i]);
+		found.push_back(Circut(extendBorder(image, 10), detections.probs[i], detections.rects[i], page.number));
+	}
+	return found;
+}
+
+std::vector<Graph> Document::findGraphs(const RenderedPage& page, Detections& detections) const
+{
+	std::vector<Graph> found;
+	for(size_t i = 0; i < detections.images.size(); ++i)
+	{
+		cv::Mat image = fullResolutionRegion(page, detections.images[i], detections.rects[i]);
+		Graph graph(extendBorder(image, 10), detections.probs[i], detections.rects[i]);
+		graph.getPoints();
+		found.push_back(graph);
+	}
+	return found;
+}
+
+std::vector<Circut> Document::findCircuts(const RenderedPage& page, Yolo5* circutYolo) const
+{
+	Detections detections = detectCircutRegions(page, circutYolo);
+	return findCircuts(page, detections);
+}
+
+std::vector<Graph> Document::findGraphs(const RenderedPage& page, Yolo5* graphYolo) const
+{
+	Detections detections = detectGraphRegions(page, graphYolo);
+	return findGraphs(page, detections);
+}
+
+bool Document::detectCircuts(Yolo5* circutYolo, Yolo5* graphYolo)
+{
+	if(pageCount() == 0)
 		return false;
-	std::vector<cv::Mat> circutImages = getYoloImages(pages, circutYolo, &probs, &rects, &pageNums);
 
-	for(size_t i = 0; i < circutImages.size(); ++i)
+	//every page is rendered once and released before the next one is rendered
+	for(size_t i = 0; i < pageCount(); ++i)
 	{
-		Circut circut(extendBorder(circutImages[i], 10), probs[i], rects[i], pageNums[i]);
+		if(pageTriaged(i))
+			continue;
+		std::vector<RenderedPage> images = pageImages(i);
+		setPageText(i, images.front());
+		for(const RenderedPage& page : images)
+		{
+			std::vector<Circut> found = findCircuts(page, circutYolo);
+			circuts.insert(circuts.end(), found.begin(), found.end());
+			if(graphYolo)
+			{
+				std::vector<Graph> foundGraphs = findGraphs(page, graphYolo);
+				graphs.insert(graphs.end(), foundGraphs.begin(), foundGraphs.end());
+			}
+		}
+	}
+
+	return true;
+}
+
+void Document::detectElements(Yolo5* elementYolo)
+{
+	static Metrics::Histogram& latency = Metrics::global().histogram("element_yolo");
+	for(Circut& circut : circuts)
+	{
+		Metrics::Timer timer(latency);
 		circut.detectElements(elementYolo);
-		circut.detectNets();
-		DirectionHint hint = circut.estimateDirection();
-		circut.setDirectionHint(hint);
-		circut.parseCircut();
-		std::string model = circut.getString();
-		if(model.size() > 2)
-			circuts.push_back(circut);
 	}
+}
 
-	probs.clear();
-	rects.clear();
+void Document::parseCircuts()
+{
+	static Metrics::Histogram& detectNetsLatency = Metrics::global().histogram("detect_nets");
+	static Metrics::Histogram& parseLatency = Metrics::global().histogram("parse_circut");
+	static Metrics::Histogram& stringLatency = Metrics::global().histogram("get_string");
 
-	if(graphYolo)
+	std::vector<Circut> parsedCircuts;
+	for(Circut& circut : circuts)
 	{
-		std::vector<cv::Mat> graphImages = getYoloImages(pages, graphYolo, &probs, &rects);
-		for(size_t i = 0; i < graphImages.size(); ++i)
 		{
-			Graph graph(extendBorder(graphImages[i], 10), probs[i], rects[i]);
-			graph.getPoints();
-			graphs.push_back(graph);
+			Metrics::Timer timer(detectNetsLatency);
+			circut.detectNets();
 		}
+		{
+			Metrics::Timer timer(parseLatency);
+			DirectionHint hint = circut.estimateDirection();
+			circut.setDirectionHint(hint);
+			circut.parseCircut();
+		}
+		std::string model;
+		{
+			Metrics::Timer timer(stringLatency);
+			model = circut.getString();
+		}
+		if(model.size() > 2)
+			parsedCircuts.push_back(circut);
 	}
+	circuts.swap(parsedCircuts);
+}
+
+bool Document::process(Yolo5* circutYolo, Yolo5* elementYolo, Yolo5* graphYolo)
+{
+	if(!detectCircuts(circutYolo, graphYolo))
+		return false;
+	detectElements(elementYolo);
+	parseCircuts();
 
 	return true;
 }
 
-std::shared_ptr<Document> Document::load(const std::string& fileName)
+uint64_t Document::LoadOptions::hash() const
+{
+	uint64_t hash = fnv1a(&pageLongSide, sizeof(pageLongSide));
+	hash = fnv1a(&gray, sizeof(gray), hash);
+	hash = fnv1a(&embeddedImages, sizeof(embeddedImages), hash);
+	hash = fnv1a(&detectLongSide, sizeof(detectLongSide), hash);
+	return pages.hash(hash);
+}
+
+std::shared_ptr<Document> Document::load(const std::string& fileName, const LoadOptions& options, const std::function<void(size_t bytes)>& admit)
 {
-	poppler::document* popdocument = poppler::document::load_from_file(fileName);
+	std::vector<char> data;
+	if(!loadFile(fileName, data))
+	{
+		Log(Log::ERROR)<<"Could not read "<<fileName;
+		return std::shared_ptr<Document>();
+	}
+
+	uint64_t contentHash = fnv1a(data.data(), data.size());
+	return load(fileName, std::move(data), contentHash, options, admit);
+}
 
-	if(!popdocument)
+std::shared_ptr<Document> Document::load(const std::string& fileName, std::vector<char> data, uint64_t contentHash,
+										 const LoadOptions& options, const std::function<void(size_t bytes)>& admit)
+{
+	//the file is read once and shared between hashing and poppler, the page source keeps it to render pages on demand
+	size_t dataSize = data.size();
+	std::shared_ptr<PageSource> pageSource = std::make_shared<PageSource>(std::move(data), options.pages, options.pageLongSide,
+																			options.gray, options.text, options.embeddedImages, options.renderHandles,
+																			options.detectLongSide);
+
+	if(!pageSource->isOpen())
 	{
 		Log(Log::ERROR)<<"Could not load pdf file from "<<fileName;
 		return std::shared_ptr<Document>();
 	}
 
+	poppler::document* popdocument = pageSource->getDocument();
 	if(popdocument->is_encrypted())
 	{
 		Log(Log::ERROR)<<"Only unencrypted files are supported";
@@ -279,24 +514,222 @@ std::shared_ptr<Document> Document::load(const std::string& fileName)
 	}
 
 	std::shared_ptr<Document> document = std::make_shared<Document>();
+	document->contentHash = contentHash;
 	document->metadata.keywords = popdocument->get_keywords().to_latin1();
 	document->metadata.title = popdocument->get_title().to_latin1();
 	document->metadata.author = popdocument->get_creator().to_latin1();
 	document->basename = std::filesystem::path(fileName).filename();
 	document->print(Log::EXTRA);
-	document->pages = getMatsFromDocument(popdocument, cv::Size(1280, 1280));
 
-	for(size_t i = 0; i < document->pages.size(); ++i)
-		document->text.push_back(popdocument->create_page(i)->text().to_latin1());
+	if(pageSource->count() < pageSource->documentPages())
+		Log(Log::DEBUG)<<"processing "<<pageSource->count()<<" of "<<pageSource->documentPages()<<" pages";
+
+	//pages are only rendered while they are processed, every page worker holds one square page at most
+	size_t channels = options.gray ? 1 : 3;
+	document->fullPageBytes = static_cast<size_t>(options.pageLongSide)*options.pageLongSide*channels;
+	document->pageBytes = document->fullPageBytes;
+	//with a detection size the held page is that small, the region rendered at full resolution next to it is charged at a quarter page
+	//larger regions are short lived, the circut images cut from them are accounted with the circuts after detection
+	if(options.detectLongSide > 0)
+		document->pageBytes = static_cast<size_t>(options.detectLongSide)*options.detectLongSide*channels + document->fullPageBytes/4;
+	document->pagesInFlight = std::max<size_t>(std::min(options.pageWorkers, pageSource->count()), 1);
+	if(admit)
+		admit(dataSize + document->pagesInFlight*document->pageBytes);
+
+	//text is extracted from the same page objects the pages are rendered from
+	if(options.text)
+		document->text.resize(pageSource->count());
+
+	document->pageSource = pageSource;
+	return document;
+}
 
-	delete popdocument;
+static std::string escapeLine(const std::string& in)
+{
+	std::string out;
+	out.reserve(in.size());
+	for(char ch : in)
+	{
+		if(ch == '\\')
+			out.append("\\\\");
+		else if(ch == '\n')
+			out.append("\\n");
+		else if(ch == '\r')
+			out.append("\\r");
+		else
+			out.push_back(ch);
+	}
+	return out;
+}
 
-	return document;
+static std::string unescapeLine(const std::string& in)
+{
+	std::string out;
+	out.reserve(in.size());
+	for(size_t i = 0; i < in.size(); ++i)
+	{
+		if(in[i] == '\\' && i+1 < in.size())
+		{
+			++i;
+			if(in[i] == 'n')
+				out.push_back('\n');
+			else if(in[i] == 'r')
+				out.push_back('\r');
+			else
+				out.push_back(in[i]);
+		}
+		else
+		{
+			out.push_back(in[i]);
+		}
+	}
+	return out;
+}
+
+static constexpr int RESULTS_FORMAT_VERSION = 1;
+
+void Document::writeResults(std::ostream& stream)
+{
+	stream<<"results "<<RESULTS_FORMAT_VERSION<<'\n';
+	stream<<"title "<<escapeLine(metadata.title)<<'\n';
+	stream<<"author "<<escapeLine(metadata.author)<<'\n';
+	stream<<"keywords "<<escapeLine(metadata.keywords)<<'\n';
+	stream<<"field "<<escapeLine(field)<<'\n';
+	for(Circut& circut : circuts)
+	{
+		cv::Rect rect = circut.getRect();
+		stream<<"circut "<<circut.getPagenum()<<' '<<circut.prob<<' '<<rect.x<<' '<<rect.y<<' '<<rect.width<<' '<<rect.height<<' '
+			<<static_cast<int>(circut.dirHint)<<' '<<escapeLine(circut.getString())<<'\n';
+	}
+	for(Graph& graph : graphs)
+	{
+		cv::Rect rect = graph.getRect();
+		stream<<"graph "<<graph.getProb()<<' '<<rect.x<<' '<<rect.y<<' '<<rect.width<<' '<<rect.height<<'\n';
+	}
+	stream<<"end\n";
+}
+
+void Document::writeJson(std::ostream& stream)
+{
+	stream<<"{\"title\":"<<jsonString(metadata.title)<<",\"author\":"<<jsonString(metadata.author)
+		<<",\"keywords\":"<<jsonString(metadata.keywords)<<",\"field\":"<<jsonString(field)
+		<<",\"hash\":"<<jsonString(hashToString(contentHash))<<",\"circuts\":[";
+	for(size_t i = 0; i < circuts.size(); ++i)
+	{
+		cv::Rect rect = circuts[i].getRect();
+		if(i > 0)
+			stream<<',';
+		stream<<"{\"page\":"<<circuts[i].getPagenum()<<",\"prob\":"<<circuts[i].prob<<",\"x\":"<<rect.x<<",\"y\":"<<rect.y
+			<<",\"width\":"<<rect.width<<",\"height\":"<<rect.height<<",\"model\":"<<jsonString(circuts[i].getString())<<'}';
+	}
+	stream<<"],\"graphs\":[";
+	for(size_t i = 0; i < graphs.size(); ++i)
+	{
+		cv::Rect rect = graphs[i].getRect();
+		if(i > 0)
+			stream<<',';
+		stream<<"{\"prob\":"<<graphs[i].getProb()<<",\"x\":"<<rect.x<<",\"y\":"<<rect.y
+			<<",\"width\":"<<rect.width<<",\"height\":"<<rect.height<<'}';
+	}
+	stream<<"]}";
+}
+
+std::shared_ptr<Document> Document::readResults(std::istream& stream, const std::string& fileName, uint64_t contentHash)
+{
+	std::shared_ptr<Document> document = std::make_shared<Document>();
+	document->basename = std::filesystem::path(fileName).filename();
+	document->contentHash = contentHash;
+
+	std::string keyword;
+	int version = -1;
+	stream>>keyword>>version;
+	if(keyword != "results" || version != RESULTS_FORMAT_VERSION)
+		return std::shared_ptr<Document>();
+
+	while(stream>>keyword)
+	{
+		if(keyword == "end")
+			return document;
+
+		std::string value;
+		if(keyword == "circut")
+		{
+			size_t page;
+			float prob;
+			cv::Rect rect;
+			int hint;
+			stream>>page>>prob>>rect.x>>rect.y>>rect.width>>rect.height>>hint;
+			stream.get();
+			std::getline(stream, value);
+			if(stream.fail() || hint < C_DIRECTION_HORIZ || hint > C_DIRECTION_UNKOWN)
+				break;
+			document->circuts.push_back(Circut(unescapeLine(value), prob, rect, page, static_cast<DirectionHint>(hint)));
+		}
+		else if(keyword == "graph")
+		{
+			float prob;
+			cv::Rect rect;
+			stream>>prob>>rect.x>>rect.y>>rect.width>>rect.height;
+			if(stream.fail())
+				break;
+			document->graphs.push_back(Graph(cv::Mat(), prob, rect));
+		}
+		else
+		{
+			stream.get();
+			std::getline(stream, value);
+			value = unescapeLine(value);
+			if(keyword == "title")
+				document->metadata.title = value;
+			else if(keyword == "author")
+				document->metadata.author = value;
+			else if(keyword == "keywords")
+				document->metadata.keywords = value;
+			else if(keyword == "field")
+				document->field = value;
+		}
+	}
+
+	//a result without end marker is truncated
+	return std::shared_ptr<Document>();
+}
+
+static size_t matBytes(const cv::Mat& mat)
+{
+	return mat.total()*mat.elemSize();
+}
+
+size_t Document::memoryUsage() const
+{
+	size_t bytes = 0;
+	if(pageSource)
+		bytes += pageSource->memoryUsage() + pagesInFlight*pageBytes;
+	for(const Circut& circut : circuts)
+	{
+		bytes += matBytes(circut.image);
+		for(const Element* element : circut.getElements())
+		{
+			const cv::Mat image = element->getImage();
+			//element images are usually views into the circut image
+			if(!image.isSubmatrix())
+				bytes += matBytes(image);
+		}
+	}
+	for(const Graph& graph : graphs)
+		bytes += matBytes(graph.getImage());
+	return bytes;
+}
+
+void Document::setPagesInFlight(size_t pages)
+{
+	//pages rendered after detection are rendered whole at full resolution
+	pagesInFlight = pages;
+	pageBytes = fullPageBytes;
 }
 
 void Document::dropImages()
 {
-	pages.clear();
+	pageSource.reset();
 	for(Circut& circut : circuts)
 		circut.dropImage();
 	for(Graph& graph : graphs)
@@ -378,6 +811,11 @@ std::string Document::getBasename() const
 	return basename;
 }
 
+uint64_t Document::getContentHash() const
+{
+	return contentHash;
+}
+
 size_t Document::circutsOnPage(size_t page) const
 {
 	size_t ret = 0;
@@ -389,13 +827,13 @@ size_t Document::circutsOnPage(size_t page) const
 	return ret;
 }
 
-std::string Document::getYoloCircutLabels(size_t page) const
+std::string Document::getYoloCircutLabels(size_t page, const cv::Mat& pageImage) const
 {
 	std::stringstream ss;
 	for(const Circut& circut : circuts)
 	{
 		if(circut.getPagenum() == page)
-			ss<<yoloLabelsFromRect(circut.getRect(), pages[page], 0);
+			ss<<yoloLabelsFromRect(circut.getRect(), pageImage, 0);
 	}
 	return ss.str();
 }
@@ -1,8 +1,12 @@
 #pragma once
 #include <memory>
+#include <cstdint>
 #include <string>
 #include <filesystem>
+#include <functional>
 #include <opencv2/core/mat.hpp>
+#include "pagesource.h"
+#include "triage.h"
 
 #include "circut.h"
 #include "graph.h"
@@ -13,6 +17,38 @@ class Document
 {
 public:
 
+	struct LoadOptions
+	{
+		//pages are rendered with their longer side at this size
+		int pageLongSide;
+		//pages are rendered and kept as single channel images
+		bool gray;
+		PageSelection pages;
+		//pages of one document rendered concurrently, each needs its own parsed copy of the pdf, does not change results
+		size_t renderHandles;
+		//pages of one document processed concurrently, each holds its rendered page until detection is done, does not change results
+		size_t pageWorkers;
+		//the text of the pages is only needed for classification, does not change results
+		bool text;
+		//pages with embedded raster figures are processed on those instead of being rendered
+		bool embeddedImages;
+		//if set circuts and graphs are detected on pages rendered at this size and only their regions are rendered at pageLongSide
+		int detectLongSide;
+
+		LoadOptions(): pageLongSide(PageSource::DEFAULT_LONG_SIDE), gray(false), renderHandles(1), pageWorkers(1), text(false), embeddedImages(false), detectLongSide(0) {}
+
+		//changes whenever an option that changes results changes
+		uint64_t hash() const;
+	};
+
+	//regions found by a network on a page, rects are in pixels of the page image
+	struct Detections
+	{
+		std::vector<cv::Mat> images;
+		std::vector<float> probs;
+		std::vector<cv::Rect> rects;
+	};
+
 	struct Metadata
 	{
 		std::string title;
@@ -25,32 +61,83 @@ private:
 	std::string field = "Unkown";
 	Metadata metadata;
 	std::string basename;
+	uint64_t contentHash = 0;
+	//renders pages on demand, released with the images
+	std::shared_ptr<PageSource> pageSource;
+	//memory accounted for pages that are rendered while the document is processed
+	size_t pageBytes = 0;
+	size_t fullPageBytes = 0;
+	size_t pagesInFlight = 0;
+
+	//the full resolution image of a region detected on page, rect is scaled to full resolution in place
+	cv::Mat fullResolutionRegion(const RenderedPage& page, const cv::Mat& crop, cv::Rect& rect) const;
 
 public:
 
-	std::vector<cv::Mat> pages;
 	std::vector<Circut> circuts;
+	//verdict for every selected page, empty unless triagePages was called
+	std::vector<TriageResult> triage;
 	std::vector<Graph> graphs;
 
 	explicit Document() = default;
-	static std::shared_ptr<Document> load(const std::string& fileName);
+	//admit is called with the estimated memory requirement of the rendered pages before rendering starts
+	static std::shared_ptr<Document> load(const std::string& fileName, const LoadOptions& options = LoadOptions(),
+										  const std::function<void(size_t bytes)>& admit = nullptr);
+	static std::shared_ptr<Document> load(const std::string& fileName, std::vector<char> data, uint64_t contentHash,
+										  const LoadOptions& options = LoadOptions(), const std::function<void(size_t bytes)>& admit = nullptr);
+	//serializes everything but images so that a document can be restored without processing it again
+	void writeResults(std::ostream& stream);
+	static std::shared_ptr<Document> readResults(std::istream& stream, const std::string& fileName, uint64_t contentHash);
+	//the same results as a single line json object
+	void writeJson(std::ostream& stream);
 
 	void dropImages();
 	void removeEmptyCircuts();
 
 	bool process(Yolo5* circutYolo, Yolo5* elementYolo, Yolo5* graphYolo);
+	//number of selected pages
+	size_t pageCount() const;
+	//renders a selected page, the page is not kept by the document
+	RenderedPage renderPage(size_t index) const;
+	//the embedded figures of a selected page if enabled and present, otherwise the rendered page
+	std::vector<RenderedPage> pageImages(size_t index) const;
+	//judges every selected page on a low resolution render
+	void triagePages();
+	bool pageTriaged(size_t index) const;
+	size_t triagedPages() const;
+	//stores the text extracted while rendering a page, safe to call concurrently for different pages
+	void setPageText(size_t index, const RenderedPage& page);
+	//finds the circuts and graphs on a single page, safe to call concurrently for different pages
+	std::vector<Circut> findCircuts(const RenderedPage& page, Yolo5* circutYolo) const;
+	std::vector<Graph> findGraphs(const RenderedPage& page, Yolo5* graphYolo) const;
+	//the same split in two steps, only the detection needs the network so it can be released before the regions are rendered at full resolution
+	Detections detectCircutRegions(const RenderedPage& page, Yolo5* circutYolo) const;
+	Detections detectGraphRegions(const RenderedPage& page, Yolo5* graphYolo) const;
+	//rects of detections are scaled to full resolution in place
+	std::vector<Circut> findCircuts(const RenderedPage& page, Detections& detections) const;
+	std::vector<Graph> findGraphs(const RenderedPage& page, Detections& detections) const;
+	//graphs are detected as well if graphYolo is given
+	bool detectCircuts(Yolo5* circutYolo, Yolo5* graphYolo = nullptr);
+	void detectElements(Yolo5* elementYolo);
+	void parseCircuts();
 	bool saveCircutImages(const std::filesystem::path& folder) const;
 	bool saveCircutLabels(const std::filesystem::path& folder) const;
 	bool saveElementLabels(const std::filesystem::path& folder) const;
 	bool saveDatafile(const std::filesystem::path& folder);
 	void print(Log::Level level) const;
+	//includes the pages that may still be rendered at once, see setPagesInFlight
+	size_t memoryUsage() const;
+	//number of full resolution pages rendered at once from now on, lowered once detection is done
+	void setPagesInFlight(size_t pages);
 	std::vector<size_t> getWordOccurances(const std::vector<std::string>& words);
 
 	std::string getBasename() const;
+	uint64_t getContentHash() const;
 	std::string getField() const;
-	std::string getYoloCircutLabels(size_t page) const;
+	std::string getYoloCircutLabels(size_t page, const cv::Mat& pageImage) const;
 	size_t circutsOnPage(size_t page) const;
 	const Metadata getMetadata() const;
+	//only available if text was requested on load and after the pages have been rendered
 	std::vector<std::string> getText();
 };
 
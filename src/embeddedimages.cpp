@@ -0,0 +1,842 @@
+#include "embeddedimages.h"
+
+#include <set>
+#include <cstring>
+#include <charconv>
+#include <algorithm>
+#include <zlib.h>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "log.h"
+
+//limits for malformed or hostile files
+static constexpr size_t MAX_STREAM_SIZE = 256*1024*1024;
+static constexpr size_t MAX_OBJECT_TEXT = 1024*1024;
+static constexpr int MAX_NESTING = 128;
+static constexpr int MAX_FORM_DEPTH = 8;
+
+static bool isWhite(char ch)
+{
+	return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t' || ch == '\f' || ch == '\0';
+}
+
+static bool isDelimiter(char ch)
+{
+	return isWhite(ch) || std::strchr("()<>[]{}/%", ch);
+}
+
+static size_t skipWhite(std::string_view text, size_t pos)
+{
+	while(pos < text.size())
+	{
+		if(text[pos] == '%')
+		{
+			while(pos < text.size() && text[pos] != '\n' && text[pos] != '\r')
+				++pos;
+		}
+		else if(isWhite(text[pos]))
+		{
+			++pos;
+		}
+		else
+		{
+			break;
+		}
+	}
+	return pos;
+}
+
+static size_t tokenEnd(std::string_view text, size_t pos)
+{
+	while(pos < text.size() && !isDelimiter(text[pos]))
+		++pos;
+	return pos;
+}
+
+static bool parseInteger(std::string_view text, size_t& value)
+{
+	if(text.empty())
+		return false;
+	std::from_chars_result result = std::from_chars(text.data(), text.data()+text.size(), value);
+	return result.ec == std::errc() && result.ptr == text.data()+text.size();
+}
+
+//returns the position just past the value starting at pos, references like 12 0 R are one value
+static size_t valueEnd(std::string_view text, size_t pos, int nesting = 0)
+{
+	if(pos >= text.size() || nesting > MAX_NESTING)
+		return text.size();
+
+	char ch = text[pos];
+	if(ch == '<' && pos+1 < text.size() && text[pos+1] == '<')
+	{
+		pos += 2;
+		while(true)
+		{
+			pos = skipWhite(text, pos);
+			if(pos >= text.size())
+				return text.size();
+			if(text.substr(pos, 2) == ">>")
+				return pos+2;
+			pos = valueEnd(text, pos, nesting+1);
+		}
+	}
+	else if(ch == '[')
+	{
+		++pos;
+		while(true)
+		{
+			pos = skipWhite(text, pos);
+			if(pos >= text.size())
+				return text.size();
+			if(text[pos] == ']')
+				return pos+1;
+			pos = valueEnd(text, pos, nesting+1);
+		}
+	}
+	else if(ch == '<')
+	{
+		size_t end = text.find('>', pos);
+		return end == std::string_view::npos ? text.size() : end+1;
+	}
+	else if(ch == '(')
+	{
+		int depth = 0;
+		for(; pos < text.size(); ++pos)
+		{
+			if(text[pos] == '\\')
+				++pos;
+			else if(text[pos] == '(')
+				++depth;
+			else if(text[pos] == ')' && --depth == 0)
+				return pos+1;
+		}
+		return text.size();
+	}
+	else if(ch == '/')
+	{
+		return tokenEnd(text, pos+1);
+	}
+	else if(isDelimiter(ch))
+	{
+		//stray closing brackets
+		return pos+1;
+	}
+
+	size_t end = tokenEnd(text, pos);
+	size_t number;
+	if(parseInteger(text.substr(pos, end-pos), number))
+	{
+		size_t generationStart = skipWhite(text, end);
+		size_t generationEnd = tokenEnd(text, generationStart);
+		if(generationEnd > generationStart && parseInteger(text.substr(generationStart, generationEnd-generationStart), number))
+		{
+			size_t r = skipWhite(text, generationEnd);
+			if(r < text.size() && text[r] == 'R' && (r+1 == text.size() || isDelimiter(text[r+1])))
+				return r+1;
+		}
+	}
+	return end;
+}
+
+//splits the top level of a dictionary into its keys, without the leading slash, and raw values
+static std::map<std::string, std::string> parseDict(std::string_view text)
+{
+	std::map<std::string, std::string> dict;
+	size_t pos = skipWhite(text, 0);
+	if(text.substr(pos, 2) != "<<")
+		return dict;
+	pos += 2;
+
+	while(true)
+	{
+		pos = skipWhite(text, pos);
+		if(pos >= text.size() || text.substr(pos, 2) == ">>")
+			break;
+		if(text[pos] != '/')
+		{
+			pos = valueEnd(text, pos);
+			continue;
+		}
+		size_t keyEnd = valueEnd(text, pos);
+		std::string key(text.substr(pos+1, keyEnd-pos-1));
+		size_t valueStart = skipWhite(text, keyEnd);
+		if(valueStart >= text.size() || text.substr(valueStart, 2) == ">>")
+			break;
+		pos = valueEnd(text, valueStart);
+		dict[key] = std::string(text.substr(valueStart, pos-valueStart));
+	}
+	return dict;
+}
+
+static std::vector<std::string> parseArray(std::string_view text)
+{
+	std::vector<std::string> array;
+	size_t pos = skipWhite(text, 0);
+	if(pos >= text.size() || text[pos] != '[')
+		return array;
+	++pos;
+
+	while(true)
+	{
+		pos = skipWhite(text, pos);
+		if(pos >= text.size() || text[pos] == ']')
+			break;
+		size_t end = valueEnd(text, pos);
+		array.push_back(std::string(text.substr(pos, end-pos)));
+		pos = end;
+	}
+	return array;
+}
+
+static bool parseReference(std::string_view value, size_t& number)
+{
+	if(value.empty() || value.back() != 'R')
+		return false;
+	return parseInteger(value.substr(0, tokenEnd(value, 0)), number);
+}
+
+static std::string dictValue(const std::map<std::string, std::string>& dict, const std::string& key)
+{
+	auto iter = dict.find(key);
+	return iter == dict.end() ? std::string() : iter->second;
+}
+
+//names of the xobjects a content stream draws with the Do operator
+static void drawnXObjects(std::string_view content, std::set<std::string>& names)
+{
+	std::string lastName;
+	size_t pos = 0;
+	while(true)
+	{
+		pos = skipWhite(content, pos);
+		if(pos >= content.size())
+			break;
+
+		char ch = content[pos];
+		if(ch == '/')
+		{
+			size_t end = tokenEnd(content, pos+1);
+			lastName = std::string(content.substr(pos+1, end-pos-1));
+			pos = end;
+			continue;
+		}
+		if(isDelimiter(ch))
+		{
+			//strings, arrays and dictionaries are operands that can contain anything
+			pos = std::max(valueEnd(content, pos), pos+1);
+			lastName.clear();
+			continue;
+		}
+
+		size_t end = tokenEnd(content, pos);
+		std::string_view token = content.substr(pos, end-pos);
+		if(token == "Do" && !lastName.empty())
+		{
+			names.insert(lastName);
+		}
+		else if(token == "ID")
+		{
+			//inline image data is binary and ends at the first EI that stands on its own
+			size_t ei = end;
+			while((ei = content.find("EI", ei+1)) != std::string_view::npos)
+			{
+				if(isWhite(content[ei-1]) && (ei+2 == content.size() || isDelimiter(content[ei+2])))
+					break;
+			}
+			end = ei == std::string_view::npos ? content.size() : ei+2;
+		}
+		lastName.clear();
+		pos = end;
+	}
+}
+
+static bool inflateData(std::string_view in, std::string& out)
+{
+	z_stream stream = {};
+	if(inflateInit(&stream) != Z_OK)
+		return false;
+	stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+	stream.avail_in = in.size();
+
+	out.clear();
+	char buffer[65536];
+	int ret;
+	do
+	{
+		stream.next_out = reinterpret_cast<Bytef*>(buffer);
+		stream.avail_out = sizeof(buffer);
+		ret = inflate(&stream, Z_NO_FLUSH);
+		if(ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+			break;
+		out.append(buffer, sizeof(buffer)-stream.avail_out);
+		if(out.size() > MAX_STREAM_SIZE)
+		{
+			ret = Z_MEM_ERROR;
+			break;
+		}
+	} while(ret == Z_OK);
+	inflateEnd(&stream);
+
+	//truncated streams are common in the wild, what could be decoded is still used
+	return ret == Z_STREAM_END || (ret == Z_BUF_ERROR && !out.empty());
+}
+
+//reverses the png row filters, every row is prefixed by its filter type
+static bool unpredictPng(std::string& buffer, size_t rowBytes, size_t bytesPerPixel)
+{
+	size_t rows = buffer.size()/(rowBytes+1);
+	std::string out(rows*rowBytes, '\0');
+	const unsigned char* in = reinterpret_cast<const unsigned char*>(buffer.data());
+	unsigned char* dst = reinterpret_cast<unsigned char*>(out.data());
+
+	for(size_t y = 0; y < rows; ++y)
+	{
+		unsigned char type = in[y*(rowBytes+1)];
+		const unsigned char* src = in + y*(rowBytes+1) + 1;
+		unsigned char* row = dst + y*rowBytes;
+		const unsigned char* prev = y > 0 ? row - rowBytes : nullptr;
+		for(size_t x = 0; x < rowBytes; ++x)
+		{
+			int a = x >= bytesPerPixel ? row[x-bytesPerPixel] : 0;
+			int b = prev ? prev[x] : 0;
+			int c = prev && x >= bytesPerPixel ? prev[x-bytesPerPixel] : 0;
+			int predicted;
+			switch(type)
+			{
+				case 0:
+					predicted = 0;
+					break;
+				case 1:
+					predicted = a;
+					break;
+				case 2:
+					predicted = b;
+					break;
+				case 3:
+					predicted = (a+b)/2;
+					break;
+				case 4:
+				{
+					int p = a+b-c;
+					int pa = std::abs(p-a);
+					int pb = std::abs(p-b);
+					int pc = std::abs(p-c);
+					predicted = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+					break;
+				}
+				default:
+					return false;
+			}
+			row[x] = static_cast<unsigned char>(src[x] + predicted);
+		}
+	}
+	buffer.swap(out);
+	return rows > 0;
+}
+
+EmbeddedImages::EmbeddedImages(std::string_view dataI): data(dataI)
+{
+	scanObjects();
+
+	//the last trailer or cross reference stream is the one of the newest revision
+	size_t rootPos = data.rfind("/Root");
+	size_t root;
+	if(rootPos == std::string_view::npos)
+		return;
+	size_t valueStart = skipWhite(data, rootPos+5);
+	if(!parseReference(data.substr(valueStart, valueEnd(data, valueStart)-valueStart), root) || !objects.count(root))
+		return;
+
+	std::map<std::string, std::string> catalog = parseDict(objects.at(root).text);
+	std::set<size_t> visited;
+	std::set<size_t> assigned;
+	if(!collectPages(resolve(dictValue(catalog, "Pages")), std::string(), 0, visited, assigned))
+	{
+		Log(Log::DEBUG)<<"Could not follow the page tree";
+		pages.clear();
+	}
+}
+
+void EmbeddedImages::scanObjects()
+{
+	std::vector<size_t> objectStreams;
+	size_t pos = 0;
+	while((pos = data.find("obj", pos)) != std::string_view::npos)
+	{
+		size_t keywordEnd = pos+3;
+		size_t i = pos;
+		pos = keywordEnd;
+		if(keywordEnd < data.size() && !isDelimiter(data[keywordEnd]))
+			continue;
+
+		//object headers are NUMBER GENERATION obj, this also skips endobj
+		if(i == 0 || !isWhite(data[i-1]))
+			continue;
+		while(i > 0 && isWhite(data[i-1]))
+			--i;
+		size_t generationEnd = i;
+		while(i > 0 && std::isdigit(static_cast<unsigned char>(data[i-1])))
+			--i;
+		if(i == generationEnd || i == 0 || !isWhite(data[i-1]))
+			continue;
+		while(i > 0 && isWhite(data[i-1]))
+			--i;
+		size_t numberEnd = i;
+		while(i > 0 && std::isdigit(static_cast<unsigned char>(data[i-1])))
+			--i;
+		size_t number;
+		if(i == numberEnd || (i > 0 && !isDelimiter(data[i-1])) || !parseInteger(data.substr(i, numberEnd-i), number))
+			continue;
+
+		size_t bodyStart = skipWhite(data, keywordEnd);
+		size_t bodyEnd = valueEnd(data, bodyStart);
+		if(bodyEnd-bodyStart > MAX_OBJECT_TEXT)
+			continue;
+
+		Object object;
+		object.text = std::string(data.substr(bodyStart, bodyEnd-bodyStart));
+		size_t after = skipWhite(data, bodyEnd);
+		if(data.substr(after, 6) == "stream")
+		{
+			size_t start = after+6;
+			if(start < data.size() && data[start] == '\r')
+				++start;
+			if(start < data.size() && data[start] == '\n')
+				++start;
+
+			//indirect lengths are not resolved, the end marker is searched instead
+			size_t length;
+			bool lengthOk = parseInteger(dictValue(parseDict(object.text), "Length"), length) && start+length <= data.size() &&
+				data.substr(skipWhite(data, start+length), 9) == "endstream";
+			if(!lengthOk)
+			{
+				size_t end = data.find("endstream", start);
+				length = (end == std::string_view::npos ? data.size() : end) - start;
+				while(length > 0 && (data[start+length-1] == '\n' || data[start+length-1] == '\r'))
+					--length;
+			}
+
+			object.stream = true;
+			object.streamOffset = start;
+			object.streamLength = length;
+			pos = start+length;
+			if(object.text.find("/ObjStm") != std::string::npos)
+				objectStreams.push_back(number);
+		}
+		else
+		{
+			pos = bodyEnd;
+		}
+		//later definitions replace earlier ones, like incremental updates do
+		objects[number] = std::move(object);
+	}
+
+	for(size_t number : objectStreams)
+	{
+		Object object = objects.at(number);
+		readObjectStream(object);
+	}
+	Log(Log::EXTRA)<<"Found "<<objects.size()<<" pdf objects";
+}
+
+void EmbeddedImages::readObjectStream(const Object& object)
+{
+	std::string content;
+	bool dct;
+	if(!streamData(object, content, dct) || dct)
+		return;
+
+	std::map<std::string, std::string> dict = parseDict(object.text);
+	size_t count;
+	size_t first;
+	if(!parseInteger(dictValue(dict, "N"), count) || !parseInteger(dictValue(dict, "First"), first) || first > content.size())
+		return;
+
+	std::string_view text(content);
+	size_t pos = 0;
+	for(size_t i = 0; i < count; ++i)
+	{
+		size_t numberStart = skipWhite(text, pos);
+		size_t numberEnd = tokenEnd(text, numberStart);
+		size_t offsetStart = skipWhite(text, numberEnd);
+		pos = tokenEnd(text, offsetStart);
+		size_t number;
+		size_t offset;
+		if(pos > first || !parseInteger(text.substr(numberStart, numberEnd-numberStart), number) ||
+			!parseInteger(text.substr(offsetStart, pos-offsetStart), offset))
+			return;
+
+		//objects stored directly in the file are usually newer revisions
+		if(objects.count(number) || first+offset >= text.size())
+			continue;
+		size_t start = skipWhite(text, first+offset);
+		Object contained;
+		contained.text = std::string(text.substr(start, valueEnd(text, start)-start));
+		objects[number] = std::move(contained);
+	}
+}
+
+std::string EmbeddedImages::resolve(const std::string& value) const
+{
+	size_t number;
+	if(!parseReference(value, number))
+		return value;
+	auto object = objects.find(number);
+	return object == objects.end() ? std::string() : object->second.text;
+}
+
+bool EmbeddedImages::integerValue(const std::map<std::string, std::string>& dict, const std::string& key, size_t& value) const
+{
+	return parseInteger(resolve(dictValue(dict, key)), value);
+}
+
+std::vector<std::string> EmbeddedImages::filters(const std::map<std::string, std::string>& dict) const
+{
+	std::vector<std::string> names;
+	std::string filter = resolve(dictValue(dict, "Filter"));
+	if(filter.empty())
+		return names;
+	if(filter[0] == '/')
+		names.push_back(filter.substr(1));
+	for(const std::string& name : parseArray(filter))
+		names.push_back(name.empty() ? name : name.substr(1));
+	return names;
+}
+
+int EmbeddedImages::colorComponents(const std::map<std::string, std::string>& dict) const
+{
+	std::string colorSpace = resolve(dictValue(dict, "ColorSpace"));
+	std::vector<std::string> array = parseArray(colorSpace);
+	std::string family = array.empty() ? colorSpace : array[0];
+
+	if(family == "/DeviceGray" || family == "/CalGray" || family == "/G")
+		return 1;
+	if(family == "/DeviceRGB" || family == "/CalRGB" || family == "/RGB")
+		return 3;
+	if(family == "/ICCBased" && array.size() > 1)
+	{
+		size_t components;
+		if(parseInteger(dictValue(parseDict(resolve(array[1])), "N"), components) && (components == 1 || components == 3))
+			return components;
+	}
+	return 0;
+}
+
+std::vector<std::map<std::string, std::string>> EmbeddedImages::decodeParameters(const std::map<std::string, std::string>& dict, size_t filterCount) const
+{
+	//a single dictionary for a single filter or an array with an entry, possibly null, for every filter of a chain
+	std::vector<std::map<std::string, std::string>> parameters(filterCount);
+	std::string value = resolve(dictValue(dict, "DecodeParms"));
+	std::vector<std::string> array = parseArray(value);
+	if(!array.empty())
+	{
+		for(size_t i = 0; i < std::min(array.size(), filterCount); ++i)
+			parameters[i] = parseDict(resolve(array[i]));
+	}
+	else if(filterCount > 0)
+	{
+		parameters[0] = parseDict(value);
+	}
+	return parameters;
+}
+
+bool EmbeddedImages::pngPredictor(const std::map<std::string, std::string>& dict, bool& predicted) const
+{
+	predicted = false;
+	std::vector<std::string> names = filters(dict);
+	std::vector<std::map<std::string, std::string>> parameters = decodeParameters(dict, names.size());
+	for(size_t i = 0; i < names.size(); ++i)
+	{
+		size_t predictor = 1;
+		integerValue(parameters[i], "Predictor", predictor);
+		if(predictor == 1)
+			continue;
+		//tiff predictors, predictors before jpeg data and more than one predicted filter are not supported
+		bool dct = names.back() == "DCTDecode" || names.back() == "DCT";
+		if(predictor < 10 || dct || predicted)
+			return false;
+		predicted = true;
+
+		//the rows the predictor works on are described by its own parameters, they have to match the image for the rows to line up
+		size_t columns = 1;
+		size_t colors = 1;
+		size_t bits = 8;
+		integerValue(parameters[i], "Columns", columns);
+		integerValue(parameters[i], "Colors", colors);
+		integerValue(parameters[i], "BitsPerComponent", bits);
+		size_t width;
+		size_t imageBits;
+		if(!integerValue(dict, "Width", width) || !integerValue(dict, "BitsPerComponent", imageBits) ||
+			columns != width || colors != static_cast<size_t>(colorComponents(dict)) || bits != imageBits)
+			return false;
+	}
+	return true;
+}
+
+bool EmbeddedImages::decodable(const std::map<std::string, std::string>& dict) const
+{
+	if(dictValue(dict, "ImageMask") == "true")
+		return false;
+
+	std::vector<std::string> names = filters(dict);
+	bool dct = !names.empty() && (names.back() == "DCTDecode" || names.back() == "DCT");
+	for(size_t i = 0; i < names.size()-(dct ? 1 : 0); ++i)
+	{
+		if(names[i] != "FlateDecode" && names[i] != "Fl")
+			return false;
+	}
+	bool predicted;
+	if(!pngPredictor(dict, predicted))
+		return false;
+	if(dct)
+		return true;
+
+	size_t bits;
+	if(!integerValue(dict, "BitsPerComponent", bits))
+		return false;
+	int components = colorComponents(dict);
+	return (bits == 8 && components != 0) || (bits == 1 && components == 1);
+}
+
+bool EmbeddedImages::streamData(const Object& object, std::string& out, bool& dct) const
+{
+	dct = false;
+	out.assign(data.substr(object.streamOffset, object.streamLength));
+
+	std::vector<std::string> names = filters(parseDict(object.text));
+	for(size_t i = 0; i < names.size(); ++i)
+	{
+		if(names[i] == "FlateDecode" || names[i] == "Fl")
+		{
+			std::string inflated;
+			if(!inflateData(out, inflated))
+				return false;
+			out.swap(inflated);
+		}
+		else if((names[i] == "DCTDecode" || names[i] == "DCT") && i+1 == names.size())
+		{
+			dct = true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool EmbeddedImages::contentData(const std::string& contents, std::string& out) const
+{
+	out.clear();
+	if(contents.empty())
+		return true;
+
+	//the contents of a page are a single stream or an array of streams that are drawn as if concatenated
+	std::vector<std::string> streams = parseArray(resolve(contents));
+	if(streams.empty())
+		streams.push_back(contents);
+	for(const std::string& stream : streams)
+	{
+		size_t number;
+		if(!parseReference(stream, number))
+			return false;
+		auto object = objects.find(number);
+		std::string part;
+		bool dct;
+		if(object == objects.end() || !object->second.stream || !streamData(object->second, part, dct) || dct)
+			return false;
+		out.append(part);
+		out.push_back('\n');
+	}
+	return true;
+}
+
+bool EmbeddedImages::collectPages(const std::string& node, const std::string& resources, int depth,
+								  std::set<size_t>& visited, std::set<size_t>& assigned)
+{
+	if(depth > MAX_NESTING)
+		return false;
+
+	std::map<std::string, std::string> dict = parseDict(node);
+	//resources are inherited from the parent nodes of the page tree
+	std::string nodeResources = dict.count("Resources") ? dict.at("Resources") : resources;
+	if(dictValue(dict, "Type") == "/Page")
+	{
+		//resources are often shared by many pages, only the images the page draws belong to it
+		Page page;
+		std::string content;
+		std::set<std::string> drawn;
+		bool known = contentData(dictValue(dict, "Contents"), content);
+		if(known)
+			drawnXObjects(content, drawn);
+		collectImages(resolve(nodeResources), known ? &drawn : nullptr, page, 0);
+
+		//images repeated on several pages, like logos or a figure shown twice, are only used on the first
+		page.images.erase(std::remove_if(page.images.begin(), page.images.end(), [&assigned](size_t number)
+		{
+			return assigned.count(number) > 0;
+		}), page.images.end());
+		assigned.insert(page.images.begin(), page.images.end());
+		pages.push_back(page);
+		return true;
+	}
+
+	std::vector<std::string> kids = parseArray(resolve(dictValue(dict, "Kids")));
+	if(kids.empty())
+		return false;
+	for(const std::string& kid : kids)
+	{
+		size_t number;
+		if(!parseReference(kid, number) || !visited.insert(number).second)
+			return false;
+		if(!collectPages(resolve(kid), nodeResources, depth+1, visited, assigned))
+			return false;
+	}
+	return true;
+}
+
+void EmbeddedImages::collectImages(const std::string& resources, const std::set<std::string>* drawn, Page& page, int depth) const
+{
+	if(depth > MAX_FORM_DEPTH)
+		return;
+
+	std::map<std::string, std::string> xobjects = parseDict(resolve(dictValue(parseDict(resources), "XObject")));
+	for(const std::pair<const std::string, std::string>& entry : xobjects)
+	{
+		size_t number;
+		if((drawn && !drawn->count(entry.first)) || !parseReference(entry.second, number))
+			continue;
+		auto object = objects.find(number);
+		if(object == objects.end() || !object->second.stream)
+			continue;
+
+		std::map<std::string, std::string> dict = parseDict(object->second.text);
+		std::string subtype = dictValue(dict, "Subtype");
+		if(subtype == "/Image")
+		{
+			size_t width;
+			size_t height;
+			if(!integerValue(dict, "Width", width) || !integerValue(dict, "Height", height) ||
+				width < MIN_FIGURE_SIDE || height < MIN_FIGURE_SIDE)
+				continue;
+			if(!decodable(dict))
+				page.undecodable = true;
+			else if(std::find(page.images.begin(), page.images.end(), number) == page.images.end())
+				page.images.push_back(number);
+		}
+		else if(subtype == "/Form")
+		{
+			//figures are often wrapped in form xobjects, the images they draw are drawn by the page
+			std::string content;
+			std::set<std::string> formDrawn;
+			bool dct;
+			bool known = streamData(object->second, content, dct) && !dct;
+			if(known)
+				drawnXObjects(content, formDrawn);
+			//forms without resources of their own use the ones of the page
+			std::string formResources = dict.count("Resources") ? resolve(dict.at("Resources")) : resources;
+			collectImages(formResources, known ? &formDrawn : nullptr, page, depth+1);
+		}
+	}
+}
+
+cv::Mat EmbeddedImages::decode(const Object& object) const
+{
+	std::string buffer;
+	bool dct;
+	if(!streamData(object, buffer, dct))
+		return cv::Mat();
+
+	if(dct)
+	{
+		cv::Mat encoded(1, buffer.size(), CV_8UC1, buffer.data());
+		return cv::imdecode(encoded, cv::IMREAD_ANYCOLOR);
+	}
+
+	std::map<std::string, std::string> dict = parseDict(object.text);
+	size_t width;
+	size_t height;
+	size_t bits;
+	int components = colorComponents(dict);
+	if(!integerValue(dict, "Width", width) || !integerValue(dict, "Height", height) || !integerValue(dict, "BitsPerComponent", bits))
+		return cv::Mat();
+
+	size_t rowBytes = (width*components*bits+7)/8;
+	bool predicted;
+	if(!pngPredictor(dict, predicted) || (predicted && !unpredictPng(buffer, rowBytes, std::max<size_t>(components*bits/8, 1))))
+		return cv::Mat();
+
+	//truncated images keep the rows that are complete
+	height = std::min(height, buffer.size()/rowBytes);
+	if(height == 0)
+		return cv::Mat();
+
+	cv::Mat image;
+	if(bits == 8)
+	{
+		cv::Mat wrapped(height, width, CV_8UC(components), buffer.data(), rowBytes);
+		if(components == 3)
+			cv::cvtColor(wrapped, image, cv::COLOR_RGB2BGR);
+		else
+			image = wrapped.clone();
+	}
+	else
+	{
+		//a set bit is white unless the decode array inverts it
+		std::vector<std::string> decodeArray = parseArray(resolve(dictValue(dict, "Decode")));
+		bool inverted = !decodeArray.empty() && decodeArray[0] == "1";
+		image.create(height, width, CV_8UC1);
+		for(size_t y = 0; y < height; ++y)
+		{
+			const unsigned char* row = reinterpret_cast<const unsigned char*>(buffer.data()) + y*rowBytes;
+			for(size_t x = 0; x < width; ++x)
+			{
+				bool set = (row[x/8] >> (7 - x%8)) & 1;
+				image.at<uchar>(y, x) = set != inverted ? 255 : 0;
+			}
+		}
+	}
+	return image;
+}
+
+size_t EmbeddedImages::pageCount() const
+{
+	return pages.size();
+}
+
+bool EmbeddedImages::hasFigures(size_t page) const
+{
+	return page < pages.size() && !pages[page].undecodable && !pages[page].images.empty();
+}
+
+std::vector<cv::Mat> EmbeddedImages::figures(size_t page, bool gray, int longSide) const
+{
+	std::vector<cv::Mat> out;
+	if(!hasFigures(page))
+		return out;
+
+	for(size_t number : pages[page].images)
+	{
+		cv::Mat image = decode(objects.at(number));
+		if(image.empty())
+		{
+			Log(Log::DEBUG)<<"Could not decode image object "<<number;
+			continue;
+		}
+		//scanned figures can be far larger than a rendered page, only one is held at native resolution at a time
+		int imageLongSide = std::max(image.cols, image.rows);
+		if(longSide > 0 && imageLongSide > longSide)
+		{
+			double scale = static_cast<double>(longSide)/imageLongSide;
+			cv::resize(image, image, cv::Size(), scale, scale, cv::INTER_AREA);
+		}
+		if(gray && image.channels() == 3)
+			cv::cvtColor(image, image, cv::COLOR_BGR2GRAY);
+		else if(!gray && image.channels() == 1)
+			cv::cvtColor(image, image, cv::COLOR_GRAY2BGR);
+		out.push_back(image);
+	}
+	return out;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <string_view>
+#include <unordered_map>
+#include <opencv2/core.hpp>
+
+//finds the raster images every page of a pdf draws by scanning the raw file, so that they can be used without rendering the page
+//only the subset of pdf needed for this is understood, documents it can not make sense of are reported as invalid
+class EmbeddedImages
+{
+private:
+	struct Object
+	{
+		//the dictionary or other value of the object
+		std::string text;
+		//only set for streams, points into the data of the pdf
+		size_t streamOffset = 0;
+		size_t streamLength = 0;
+		bool stream = false;
+	};
+
+	struct Page
+	{
+		std::vector<size_t> images;
+		//images that are too small to be figures are ignored, large ones that can not be decoded make the page fall back to rendering
+		bool undecodable = false;
+	};
+
+	std::string_view data;
+	std::unordered_map<size_t, Object> objects;
+	std::vector<Page> pages;
+
+	void scanObjects();
+	void readObjectStream(const Object& object);
+	//the text of the referenced object if value is a reference
+	std::string resolve(const std::string& value) const;
+	bool integerValue(const std::map<std::string, std::string>& dict, const std::string& key, size_t& value) const;
+	std::vector<std::string> filters(const std::map<std::string, std::string>& dict) const;
+	//0 for color spaces that are not supported
+	int colorComponents(const std::map<std::string, std::string>& dict) const;
+	//concatenated data of the content streams of a page, false if they can not be read
+	bool contentData(const std::string& contents, std::string& out) const;
+	//assigned holds the images already used by earlier pages
+	bool collectPages(const std::string& node, const std::string& resources, int depth, std::set<size_t>& visited, std::set<size_t>& assigned);
+	//only the xobjects in drawn are considered, all of them if drawn is null
+	void collectImages(const std::string& resources, const std::set<std::string>* drawn, Page& page, int depth) const;
+	//the decode parameters of every filter in the order of the filters, empty for filters without
+	std::vector<std::map<std::string, std::string>> decodeParameters(const std::map<std::string, std::string>& dict, size_t filterCount) const;
+	//false if a predictor is used that can not be undone or whose parameters do not match the image, predicted is set if a png predictor is used
+	bool pngPredictor(const std::map<std::string, std::string>& dict, bool& predicted) const;
+	bool decodable(const std::map<std::string, std::string>& dict) const;
+	//applies all filters but a final DCTDecode, dct is set if the data is still jpeg compressed
+	bool streamData(const Object& object, std::string& out, bool& dct) const;
+	cv::Mat decode(const Object& object) const;
+
+public:
+	static constexpr int MIN_FIGURE_SIDE = 200;
+
+	//data is not copied and has to outlive the index
+	EmbeddedImages(std::string_view dataI);
+
+	//number of pages found in the page tree
+	size_t pageCount() const;
+	//false if the page has no figure or has one that can not be decoded, the page then has to be rendered
+	bool hasFigures(size_t page) const;
+	//the figures of a page in the channel layout of rendered pages, figures with a long side larger than longSide are scaled down to it
+	std::vector<cv::Mat> figures(size_t page, bool gray, int longSide = 0) const;
+};
@@ -0,0 +1,128 @@
+#include "fileenumerator.h"
+
+#include <iostream>
+#include <system_error>
+
+#include "log.h"
+
+FileEnumerator::FileEnumerator(const std::vector<std::filesystem::path>& rootsI, const std::filesystem::path& fileListI):
+roots(rootsI), listFileName(fileListI)
+{
+}
+
+bool FileEnumerator::open()
+{
+	if(listFileName.empty())
+		return true;
+
+	if(listFileName == "-")
+	{
+		list = &std::cin;
+		return true;
+	}
+
+	listFile.open(listFileName, std::ios_base::in);
+	if(!listFile.is_open())
+	{
+		Log(Log::ERROR)<<"Could not open file list "<<listFileName;
+		return false;
+	}
+	list = &listFile;
+	return true;
+}
+
+bool FileEnumerator::readListEntry(std::filesystem::path& path)
+{
+	while(list && list->good())
+	{
+		std::string entry;
+		char ch;
+		while(list->get(ch) && ch != '\n' && ch != '\0')
+			entry.push_back(ch);
+		if(!entry.empty() && entry.back() == '\r')
+			entry.pop_back();
+		if(!entry.empty())
+		{
+			path = entry;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FileEnumerator::nextRoot(std::filesystem::path& path)
+{
+	if(rootIndex < roots.size())
+	{
+		path = roots[rootIndex++];
+		return true;
+	}
+	return readListEntry(path);
+}
+
+bool FileEnumerator::nextInDirectory(std::filesystem::path& path)
+{
+	std::error_code ec;
+	while(directory != std::filesystem::recursive_directory_iterator())
+	{
+		const std::filesystem::directory_entry& dirent = *directory;
+		bool regular = dirent.is_regular_file(ec);
+		if(!ec && regular)
+			path = dirent.path();
+
+		directory.increment(ec);
+		if(ec)
+		{
+			Log(Log::WARN)<<"Error while walking directory: "<<ec.message();
+			directory = std::filesystem::recursive_directory_iterator();
+		}
+
+		if(regular)
+			return true;
+	}
+	inDirectory = false;
+	return false;
+}
+
+bool FileEnumerator::next(std::filesystem::path& path)
+{
+	while(true)
+	{
+		if(inDirectory && nextInDirectory(path))
+		{
+			++count;
+			return true;
+		}
+
+		std::filesystem::path root;
+		if(!nextRoot(root))
+			return false;
+
+		std::error_code ec;
+		std::filesystem::file_status status = std::filesystem::status(root, ec);
+		if(std::filesystem::is_regular_file(status))
+		{
+			path = root;
+			++count;
+			return true;
+		}
+		else if(std::filesystem::is_directory(status))
+		{
+			//symlinks to directories are not followed below the root to avoid cycles
+			directory = std::filesystem::recursive_directory_iterator(root, std::filesystem::directory_options::skip_permission_denied, ec);
+			if(ec)
+				Log(Log::WARN)<<"Could not open directory "<<root<<": "<<ec.message();
+			else
+				inDirectory = true;
+		}
+		else
+		{
+			Log(Log::WARN)<<root<<" is not a file or directory, skipping";
+		}
+	}
+}
+
+size_t FileEnumerator::getCount() const
+{
+	return count;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <fstream>
+#include <istream>
+#include <filesystem>
+
+//lazily walks the given paths and an optional list of paths so that files can be processed while they are still being discovered
+class FileEnumerator
+{
+private:
+	std::vector<std::filesystem::path> roots;
+	size_t rootIndex = 0;
+	std::filesystem::path listFileName;
+	std::fstream listFile;
+	std::istream* list = nullptr;
+	std::filesystem::recursive_directory_iterator directory;
+	bool inDirectory = false;
+	size_t count = 0;
+
+private:
+	bool nextRoot(std::filesystem::path& path);
+	bool readListEntry(std::filesystem::path& path);
+	bool nextInDirectory(std::filesystem::path& path);
+
+public:
+	//fileList may be - for stdin, entries are separated by newlines or NUL characters
+	FileEnumerator(const std::vector<std::filesystem::path>& rootsI, const std::filesystem::path& fileListI = std::filesystem::path());
+	bool open();
+	//returns false once all files have been enumerated
+	bool next(std::filesystem::path& path);
+	size_t getCount() const;
+};
@@ -18,7 +18,7 @@ public:
 	Graph() = default;
 	Graph(const cv::Mat& imageI, float probI, cv::Rect rectI);
 	void setImage(cv::Mat& imageI) {image = imageI;}
-	cv::Mat getImage() {return image;}
+	cv::Mat getImage() const {return image;}
 	void setRect(const cv::Rect& rectI) {rect = rectI;}
 	cv::Rect getRect() {return rect;}
 	void setProb(float in) {prob = in;}
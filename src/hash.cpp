@@ -0,0 +1,41 @@
+#include "hash.h"
+
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+static constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for(size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+std::string hashToString(uint64_t hash)
+{
+	std::stringstream ss;
+	ss<<std::hex<<std::setw(16)<<std::setfill('0')<<hash;
+	return ss.str();
+}
+
+bool hashFromString(const std::string& str, uint64_t& hash)
+{
+	if(str.size() != 16)
+		return false;
+	try
+	{
+		size_t pos;
+		hash = std::stoull(str, &pos, 16);
+		return pos == str.size();
+	}
+	catch(const std::logic_error& ex)
+	{
+		return false;
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+static constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+
+//64 bit FNV-1a, pass a previous result as hash to continue hashing
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash = FNV_OFFSET);
+
+std::string hashToString(uint64_t hash);
+
+bool hashFromString(const std::string& str, uint64_t& hash);
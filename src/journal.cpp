@@ -0,0 +1,198 @@
+#include "journal.h"
+
+#include <sstream>
+#include <system_error>
+
+#include "hash.h"
+#include "log.h"
+#include "tokenize.h"
+
+const char* Journal::statusString(Status status)
+{
+	switch(status)
+	{
+		case STATUS_DONE:
+			return "done";
+		case STATUS_FAILED:
+			return "failed";
+		case STATUS_ERROR:
+		default:
+			return "error";
+	}
+}
+
+bool Journal::statusFromString(const std::string& str, Status& status)
+{
+	if(str == "done")
+		status = STATUS_DONE;
+	else if(str == "failed")
+		status = STATUS_FAILED;
+	else if(str == "error")
+		status = STATUS_ERROR;
+	else
+		return false;
+	return true;
+}
+
+bool Journal::fileStat(const std::filesystem::path& path, uintmax_t& size, int64_t& mtime)
+{
+	std::error_code ec;
+	size = std::filesystem::file_size(path, ec);
+	if(ec)
+		return false;
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(path, ec);
+	if(ec)
+		return false;
+	mtime = time.time_since_epoch().count();
+	return true;
+}
+
+std::string Journal::key(const std::filesystem::path& path)
+{
+	std::error_code ec;
+	std::filesystem::path absolute = std::filesystem::absolute(path, ec);
+	return ec ? path.string() : absolute.lexically_normal().string();
+}
+
+bool Journal::load(const std::filesystem::path& path)
+{
+	std::fstream in(path, std::ios_base::in);
+	if(!in.is_open())
+		return false;
+
+	size_t lineNumber = 0;
+	while(in.good())
+	{
+		std::string line;
+		std::getline(in, line);
+		++lineNumber;
+		//a line without newline was cut short by a crash
+		if(line.empty() || in.eof())
+			continue;
+
+		std::vector<std::string> tokens = tokenize(line, "\t");
+		Entry entry;
+		if(tokens.size() < 5 || !statusFromString(tokens[0], entry.status) || !hashFromString(tokens[3], entry.hash))
+		{
+			Log(Log::WARN)<<"Ignoreing invalid journal line "<<lineNumber;
+			continue;
+		}
+
+		try
+		{
+			entry.size = std::stoull(tokens[1]);
+			entry.mtime = std::stoll(tokens[2]);
+		}
+		catch(const std::logic_error& ex)
+		{
+			Log(Log::WARN)<<"Ignoreing invalid journal line "<<lineNumber;
+			continue;
+		}
+
+		//the path is the last field and may itself contain tabs
+		std::string filePath = line.substr(tokens[0].size() + tokens[1].size() + tokens[2].size() + tokens[3].size() + 4);
+		entries[filePath] = entry;
+	}
+	return true;
+}
+
+bool Journal::open(const std::filesystem::path& path, bool resume)
+{
+	std::scoped_lock lock(mutex);
+
+	bool needsNewline = false;
+	if(resume && std::filesystem::exists(path))
+	{
+		if(!load(path))
+		{
+			Log(Log::ERROR)<<"Could not read journal "<<path;
+			return false;
+		}
+		Log(Log::INFO)<<"Loaded "<<entries.size()<<" entries from journal "<<path;
+
+		std::fstream in(path, std::ios_base::in | std::ios_base::binary);
+		in.seekg(0, std::ios_base::end);
+		if(in.tellg() > 0)
+		{
+			in.seekg(-1, std::ios_base::end);
+			needsNewline = in.get() != '\n';
+		}
+	}
+
+	file.open(path, std::ios_base::out | (resume ? std::ios_base::app : std::ios_base::trunc));
+	if(!file.is_open())
+	{
+		Log(Log::ERROR)<<"Could not open journal "<<path<<" for writeing";
+		return false;
+	}
+
+	if(needsNewline)
+		file<<std::endl;
+	return true;
+}
+
+bool Journal::find(const std::filesystem::path& path, Entry& entry) const
+{
+	std::scoped_lock lock(mutex);
+	auto iterator = entries.find(key(path));
+	if(iterator == entries.end())
+		return false;
+	entry = iterator->second;
+	return true;
+}
+
+bool Journal::isComplete(const std::filesystem::path& path) const
+{
+	Entry entry;
+	if(!find(path, entry) || entry.status == STATUS_ERROR)
+		return false;
+
+	uintmax_t size;
+	int64_t mtime;
+	if(!fileStat(path, size, mtime))
+		return false;
+	return size == entry.size && mtime == entry.mtime;
+}
+
+void Journal::record(const std::filesystem::path& path, Status status, uint64_t hash)
+{
+	Entry entry;
+	entry.status = status;
+	entry.hash = hash;
+	if(!fileStat(path, entry.size, entry.mtime))
+	{
+		entry.size = 0;
+		entry.mtime = 0;
+	}
+
+	std::string filePath = key(path);
+	std::stringstream ss;
+	ss<<statusString(status)<<'\t'<<entry.size<<'\t'<<entry.mtime<<'\t'<<hashToString(hash)<<'\t'<<filePath<<'\n';
+
+	std::scoped_lock lock(mutex);
+	entries[filePath] = entry;
+	if(!file.is_open())
+		return;
+	//every entry is flushed on its own so that a crash looses at most the line being written
+	file<<ss.str()<<std::flush;
+	if(file.fail())
+		Log(Log::ERROR)<<"Could not write to journal";
+}
+
+size_t Journal::size() const
+{
+	std::scoped_lock lock(mutex);
+	return entries.size();
+}
+
+size_t Journal::count(Status status) const
+{
+	std::scoped_lock lock(mutex);
+	size_t count = 0;
+	for(const std::pair<const std::string, Entry>& entry : entries)
+	{
+		if(entry.second.status == status)
+			++count;
+	}
+	return count;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <mutex>
+#include <fstream>
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+
+//append only record of processed files, used to resume interrupted runs
+class Journal
+{
+public:
+	enum Status
+	{
+		STATUS_DONE = 0,
+		STATUS_FAILED,
+		STATUS_ERROR,
+	};
+
+	struct Entry
+	{
+		Status status;
+		uintmax_t size;
+		int64_t mtime;
+		uint64_t hash;
+	};
+
+private:
+	std::fstream file;
+	std::unordered_map<std::string, Entry> entries;
+	mutable std::mutex mutex;
+
+private:
+	static const char* statusString(Status status);
+	static bool statusFromString(const std::string& str, Status& status);
+	static bool fileStat(const std::filesystem::path& path, uintmax_t& size, int64_t& mtime);
+	static std::string key(const std::filesystem::path& path);
+	bool load(const std::filesystem::path& path);
+
+public:
+	//without resume an existing journal is truncated
+	bool open(const std::filesystem::path& path, bool resume);
+	//true if the file was recorded as done or failed and is unchanged since
+	bool isComplete(const std::filesystem::path& path) const;
+	bool find(const std::filesystem::path& path, Entry& entry) const;
+	void record(const std::filesystem::path& path, Status status, uint64_t hash);
+	size_t size() const;
+	size_t count(Status status) const;
+};
@@ -0,0 +1,210 @@
+#include "json.h"
+
+#include <cstdio>
+#include <cctype>
+
+std::string jsonString(const std::string& in)
+{
+	std::string out;
+	out.reserve(in.size()+2);
+	out.push_back('"');
+	for(char ch : in)
+	{
+		switch(ch)
+		{
+			case '"':
+				out.append("\\\"");
+				break;
+			case '\\':
+				out.append("\\\\");
+				break;
+			case '\n':
+				out.append("\\n");
+				break;
+			case '\r':
+				out.append("\\r");
+				break;
+			case '\t':
+				out.append("\\t");
+				break;
+			default:
+				if(static_cast<unsigned char>(ch) < 0x20)
+				{
+					char buffer[8];
+					snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned>(ch));
+					out.append(buffer);
+				}
+				else
+				{
+					out.push_back(ch);
+				}
+		}
+	}
+	out.push_back('"');
+	return out;
+}
+
+static void skipSpace(const std::string& in, size_t& pos)
+{
+	while(pos < in.size() && std::isspace(static_cast<unsigned char>(in[pos])))
+		++pos;
+}
+
+static void appendUtf8(std::string& out, unsigned codepoint)
+{
+	if(codepoint < 0x80)
+	{
+		out.push_back(codepoint);
+	}
+	else if(codepoint < 0x800)
+	{
+		out.push_back(0xC0 | (codepoint >> 6));
+		out.push_back(0x80 | (codepoint & 0x3F));
+	}
+	else if(codepoint < 0x10000)
+	{
+		out.push_back(0xE0 | (codepoint >> 12));
+		out.push_back(0x80 | ((codepoint >> 6) & 0x3F));
+		out.push_back(0x80 | (codepoint & 0x3F));
+	}
+	else
+	{
+		out.push_back(0xF0 | (codepoint >> 18));
+		out.push_back(0x80 | ((codepoint >> 12) & 0x3F));
+		out.push_back(0x80 | ((codepoint >> 6) & 0x3F));
+		out.push_back(0x80 | (codepoint & 0x3F));
+	}
+}
+
+static bool parseHex4(const std::string& in, size_t& pos, unsigned& value)
+{
+	if(pos+4 > in.size())
+		return false;
+	value = 0;
+	for(size_t i = 0; i < 4; ++i)
+	{
+		char ch = in[pos+i];
+		if(!std::isxdigit(static_cast<unsigned char>(ch)))
+			return false;
+		value = value*16 + (std::isdigit(static_cast<unsigned char>(ch)) ? ch - '0' : std::tolower(static_cast<unsigned char>(ch)) - 'a' + 10);
+	}
+	pos += 4;
+	return true;
+}
+
+static bool parseString(const std::string& in, size_t& pos, std::string& out)
+{
+	if(pos >= in.size() || in[pos] != '"')
+		return false;
+	++pos;
+	while(pos < in.size())
+	{
+		char ch = in[pos++];
+		if(ch == '"')
+			return true;
+		if(ch != '\\')
+		{
+			out.push_back(ch);
+			continue;
+		}
+		if(pos >= in.size())
+			return false;
+		ch = in[pos++];
+		switch(ch)
+		{
+			case 'n':
+				out.push_back('\n');
+				break;
+			case 'r':
+				out.push_back('\r');
+				break;
+			case 't':
+				out.push_back('\t');
+				break;
+			case 'b':
+				out.push_back('\b');
+				break;
+			case 'f':
+				out.push_back('\f');
+				break;
+			case 'u':
+			{
+				unsigned codepoint;
+				if(!parseHex4(in, pos, codepoint))
+					return false;
+				//characters outside the basic plane are escaped as a high surrogate followed by a low one
+				if(codepoint >= 0xDC00 && codepoint <= 0xDFFF)
+					return false;
+				if(codepoint >= 0xD800 && codepoint <= 0xDBFF)
+				{
+					unsigned low;
+					if(in.compare(pos, 2, "\\u") != 0)
+						return false;
+					pos += 2;
+					if(!parseHex4(in, pos, low) || low < 0xDC00 || low > 0xDFFF)
+						return false;
+					codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+				}
+				appendUtf8(out, codepoint);
+				break;
+			}
+			default:
+				out.push_back(ch);
+		}
+	}
+	return false;
+}
+
+bool parseJsonObject(const std::string& in, std::map<std::string, std::string>& values)
+{
+	size_t pos = 0;
+	skipSpace(in, pos);
+	if(pos >= in.size() || in[pos] != '{')
+		return false;
+	++pos;
+	skipSpace(in, pos);
+	if(pos < in.size() && in[pos] == '}')
+		return true;
+
+	while(pos < in.size())
+	{
+		std::string key;
+		skipSpace(in, pos);
+		if(!parseString(in, pos, key))
+			return false;
+		skipSpace(in, pos);
+		if(pos >= in.size() || in[pos] != ':')
+			return false;
+		++pos;
+		skipSpace(in, pos);
+
+		std::string value;
+		if(pos < in.size() && in[pos] == '"')
+		{
+			if(!parseString(in, pos, value))
+				return false;
+		}
+		else
+		{
+			while(pos < in.size() && in[pos] != ',' && in[pos] != '}' && !std::isspace(static_cast<unsigned char>(in[pos])))
+			{
+				if(in[pos] == '{' || in[pos] == '[')
+					return false;
+				value.push_back(in[pos++]);
+			}
+			if(value.empty())
+				return false;
+		}
+		values[key] = value;
+
+		skipSpace(in, pos);
+		if(pos >= in.size())
+			return false;
+		if(in[pos] == '}')
+			return true;
+		if(in[pos] != ',')
+			return false;
+		++pos;
+	}
+	return false;
+}
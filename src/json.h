@@ -0,0 +1,10 @@
+#pragma once
+#include <map>
+#include <string>
+
+//quotes and escapes a string for use as a json string value
+std::string jsonString(const std::string& in);
+
+//parses a single flat json object, nested objects and arrays are not supported
+//string values are unescaped, numbers and literals are returned as written
+bool parseJsonObject(const std::string& in, std::map<std::string, std::string>& values);
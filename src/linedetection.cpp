@@ -266,7 +266,10 @@ std::vector<cv::Vec4f> lineDetect(cv::Mat in)
 	cv::Mat vizualization;
 	std::vector<cv::Vec4f> lines;
 
-	cv::cvtColor(in, work, cv::COLOR_BGR2GRAY);
+	if(in.channels() == 1)
+		in.copyTo(work);
+	else
+		cv::cvtColor(in, work, cv::COLOR_BGR2GRAY);
 	cv::resize(work, work, cv::Size(), SCALE_FACTOR, SCALE_FACTOR, cv::INTER_LINEAR);
 	work.convertTo(work, CV_8U, 1);
 	cv::threshold(work, work, 200, std::numeric_limits<uint8_t>::max(), cv::THRESH_BINARY);
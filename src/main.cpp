@@ -1,26 +1,51 @@
 #include <iostream>
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
+#include <opencv2/core/utility.hpp>
 #include <poppler-document.h>
 #include <poppler-image.h>
 #include <poppler-global.h>
 #include <filesystem>
 #include <fstream>
 #include <vector>
-#include <future>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <latch>
+#include <algorithm>
 #include <set>
+#include <csignal>
+#include <chrono>
+#include <atomic>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
 
 #include "log.h"
 #include "popplertocv.h"
 #include "yolo.h"
+#include "yolopool.h"
 #include "document.h"
 #include "circut.h"
 #include "randomgen.h"
 #include "options.h"
 #include "resources.h"
-
-#define THREADS 16
+#include "pipeline.h"
+#include "cpus.h"
+#include "memorybudget.h"
+#include "workstealingpool.h"
+#include "journal.h"
+#include "resultcache.h"
+#include "hash.h"
+#include "utils.h"
+#include "statistics.h"
+#include "scheduling.h"
+#include "fileenumerator.h"
+#include "daemon.h"
+#include "metrics.h"
+#include "progress.h"
+#include "placement.h"
 
 /*
 static void cleanDocuments(std::vector<std::shared_ptr<Document>> documents)
@@ -37,21 +62,41 @@ static void cleanDocuments(std::vector<std::shared_ptr<Document>> documents)
 }
 */
 
+//bump whenever a change to processing changes results so that cached results are invalidated
+static constexpr uint64_t RESULTS_VERSION = 4;
+
 static bool save(std::shared_ptr<Document> document, const Config config)
 {
 	bool result = true;
 	if(!document->circuts.empty())
 	{
+		static Metrics::Histogram& circutImagesLatency = Metrics::global().histogram("save_circut_images");
+		static Metrics::Histogram& circutLabelsLatency = Metrics::global().histogram("save_circut_labels");
+		static Metrics::Histogram& elementLabelsLatency = Metrics::global().histogram("save_element_labels");
+		static Metrics::Histogram& datafileLatency = Metrics::global().histogram("save_datafile");
+
 		int ret = 0;
 		if(config.outputCircut)
+		{
+			Metrics::Timer timer(circutImagesLatency);
 			ret += document->saveCircutImages(config.outDir/"circuts");
+		}
 		if(config.outputCircutLabels)
+		{
+			Metrics::Timer timer(circutLabelsLatency);
 			ret += document->saveCircutLabels(config.outDir/"circutLabels");
+		}
 		if(config.outputElementLabels)
+		{
+			Metrics::Timer timer(elementLabelsLatency);
 			ret += document->saveElementLabels(config.outDir/"elementLabels");
+		}
 		if(config.outputSummaries)
+		{
+			Metrics::Timer timer(datafileLatency);
 			ret += document->saveDatafile(config.outDir/"summaries");
-		if(ret != config.outputCircut + config.outputSummaries + config.outputElementLabels)
+		}
+		if(ret != config.outputCircut + config.outputCircutLabels + config.outputSummaries + config.outputElementLabels)
 		{
 			Log(Log::WARN)<<"Error saveing files for "<<document->getBasename();
 			result = false;
@@ -62,58 +107,275 @@ static bool save(std::shared_ptr<Document> document, const Config config)
 	return result;
 }
 
-static bool process(std::shared_ptr<Document> document,
-					Yolo5* circutYolo, Yolo5* elementYolo, Yolo5* graphYolo,
-					const Config& config)
+//updates the memory accounted to a job after every stage
+static Pipeline::StageFunction accounted(Pipeline::StageFunction function)
 {
-	document->process(circutYolo, elementYolo, graphYolo);
-	std::thread(save, document, config).detach();
-	return true;
+	return [function](Job& job) -> bool
+	{
+		bool ret = function(job);
+		if(job.document)
+			job.reservation.resize(job.document->memoryUsage());
+		return ret;
+	};
 }
 
-static void dropMessage(const std::string& message, void* userdata)
+struct Workers
 {
-	(void)message;
-	(void)userdata;
+	WorkStealingPool* pageWorkers;
+	Yolo5Pool* circutYolos;
+	Yolo5Pool* elementYolos;
+	Yolo5Pool* graphYolos;
+	MemoryBudget* budget;
+	ResultCache* cache;
+	bool cacheLookups;
+	const Placement* placement;
+};
+
+static Document::LoadOptions loadOptions(const Config& config)
+{
+	Document::LoadOptions options;
+	options.gray = config.gray;
+	options.pages = config.pages;
+	options.renderHandles = config.renderHandles;
+	options.pageWorkers = config.inferenceThreads;
+	options.text = !config.baysenFileName.empty();
+	options.embeddedImages = config.embeddedImages;
+	options.detectLongSide = config.detectSide;
+	return options;
 }
 
-std::vector<std::filesystem::path> toFilePaths(const std::vector<std::filesystem::path>& paths)
+static void addStages(Pipeline& pipeline, const Workers& workers, const Config& config)
 {
-	std::vector<std::filesystem::path> filePaths;
+	Document::LoadOptions loadOptions = ::loadOptions(config);
+	MemoryBudget* budget = workers.budget;
+	ResultCache* cache = workers.cache;
+	WorkStealingPool* pageWorkers = workers.pageWorkers;
+	Yolo5Pool* circutYolos = workers.circutYolos;
+	Yolo5Pool* elementYolos = workers.elementYolos;
+	Yolo5Pool* graphYolos = workers.graphYolos;
+	bool cacheLookups = cache && workers.cacheLookups;
+	const Placement* placement = workers.placement;
+	//the page workers take the first inferenceThreads cpus of the plan, the element stage the ones after them
+	size_t elementSlots = config.inferenceThreads;
+	Pipeline::ThreadInit pinElement = [placement, elementSlots](size_t worker){placement->pinInference(elementSlots + worker);};
+	Pipeline::ThreadInit pinOther = [placement](size_t worker){(void)worker; placement->pinOther();};
+
+	pipeline.addStage("load", accounted([budget, cache, cacheLookups, loadOptions](Job& job) -> bool
+	{
+		Log(Log::INFO)<<"Loading document "<<job.index<<": "<<job.path;
+		std::vector<char> data;
+		if(!loadFile(job.path, data))
+			return false;
+		uint64_t contentHash = fnv1a(data.data(), data.size());
+
+		if(cacheLookups)
+		{
+			job.document = cache->find(contentHash, job.path);
+			if(job.document)
+			{
+				job.cached = true;
+				return true;
+			}
+		}
+
+		job.document = Document::load(job.path, std::move(data), contentHash, loadOptions, [budget, &job](size_t bytes)
+		{
+			job.reservation = budget->reserve(bytes);
+		});
+		if(!job.document)
+			return false;
+		job.pages = job.document->pageCount();
+		return true;
+	}), config.loadThreads, config.loadThreads, pinOther);
+
+	//the circut stage workers only coordinate, the pages of every document are processed by the work stealing pool
+	if(config.triage != TRIAGE_OFF)
+	{
+		pipeline.addStage("triage", accounted([](Job& job) -> bool
+		{
+			if(job.cached)
+				return true;
+			static Metrics::Counter& triagePages = Metrics::global().counter("triage_pages");
+			static Metrics::Counter& triageSkipped = Metrics::global().counter("triage_skipped_pages");
+			job.document->triagePages();
+			triagePages.add(job.document->triage.size());
+			for(const TriageResult& result : job.document->triage)
+			{
+				if(!result.skip())
+					continue;
+				triageSkipped.add();
+				Metrics::global().counter("triage_" + TriageResult::verdictName(result.verdict) + "_pages").add();
+			}
+			return true;
+		}), config.loadThreads, config.loadThreads, pinOther);
+	}
 
-	for(const std::filesystem::path& pathC : paths)
+	//in audit mode triaged pages are still processed to count the circuts triage would miss
+	bool skipTriaged = config.triage == TRIAGE_ON;
+	bool rerenderPages = config.outputCircutLabels;
+	pipeline.addStage("circut", accounted([pageWorkers, circutYolos, graphYolos, skipTriaged, rerenderPages](Job& job) -> bool
 	{
-		std::filesystem::path path = pathC;
-		if(std::filesystem::is_symlink(path))
-			path = std::filesystem::read_symlink(path);
-		if(std::filesystem::is_regular_file(path))
+		if(job.cached)
+			return true;
+
+		Document& document = *job.document;
+		size_t pageCount = document.pageCount();
+		std::vector<std::vector<Circut>> pageCircuts(pageCount);
+		std::vector<std::vector<Graph>> pageGraphs(pageCount);
+		std::latch pagesDone(pageCount);
+
+		std::vector<WorkStealingPool::Task> tasks;
+		for(size_t i = 0; i < pageCount; ++i)
 		{
-			filePaths.push_back(path);
+			tasks.push_back([&, i]()
+			{
+				try
+				{
+					if(skipTriaged && document.pageTriaged(i))
+					{
+						pagesDone.count_down();
+						return;
+					}
+					//the page is rendered by the worker that processes it and released once both detectors ran
+					std::vector<RenderedPage> images = document.pageImages(i);
+					document.setPageText(i, images.front());
+					for(const RenderedPage& page : images)
+					{
+						//networks are returned before the detected regions are rendered at full resolution
+						Document::Detections circutDetections;
+						{
+							Yolo5Pool::Lease yolo = circutYolos->checkout(Placement::currentNode());
+							circutDetections = document.detectCircutRegions(page, yolo.get());
+						}
+						std::vector<Circut> found = document.findCircuts(page, circutDetections);
+						pageCircuts[i].insert(pageCircuts[i].end(), found.begin(), found.end());
+						if(graphYolos)
+						{
+							Document::Detections graphDetections;
+							{
+								Yolo5Pool::Lease yolo = graphYolos->checkout(Placement::currentNode());
+								graphDetections = document.detectGraphRegions(page, yolo.get());
+							}
+							std::vector<Graph> foundGraphs = document.findGraphs(page, graphDetections);
+							pageGraphs[i].insert(pageGraphs[i].end(), foundGraphs.begin(), foundGraphs.end());
+						}
+					}
+				}
+				catch(const std::exception& ex)
+				{
+					Log(Log::ERROR)<<"Failed to process page "<<i<<" of "<<job.path<<": "<<ex.what();
+				}
+				pagesDone.count_down();
+			});
 		}
-		else if(std::filesystem::is_directory(path))
+		pageWorkers->submit(std::move(tasks));
+		pagesDone.wait();
+
+		for(size_t i = 0; i < pageCount; ++i)
 		{
-			for(const std::filesystem::directory_entry& dirent : std::filesystem::directory_iterator(path))
+			if(!skipTriaged && document.pageTriaged(i) && !pageCircuts[i].empty())
 			{
-				std::filesystem::path filePath = dirent.path();
-				if(std::filesystem::is_symlink(filePath))
-					filePath = std::filesystem::read_symlink(filePath);
-				if(std::filesystem::is_regular_file(filePath))
-					filePaths.push_back(filePath);
+				static Metrics::Counter& missedPages = Metrics::global().counter("triage_missed_pages");
+				static Metrics::Counter& missedCircuts = Metrics::global().counter("triage_missed_circuts");
+				missedPages.add();
+				missedCircuts.add(pageCircuts[i].size());
+				Log(Log::INFO)<<"Triage would miss "<<pageCircuts[i].size()<<" circuts on page "<<pageCircuts[i].front().getPagenum()
+					<<" of "<<job.path<<" judged "<<TriageResult::verdictName(document.triage[i].verdict);
 			}
+			document.circuts.insert(document.circuts.end(), pageCircuts[i].begin(), pageCircuts[i].end());
+			document.graphs.insert(document.graphs.end(), pageGraphs[i].begin(), pageGraphs[i].end());
 		}
-	}
+		//saving circut labels renders one page at a time again
+		document.setPagesInFlight(rerenderPages ? 1 : 0);
+		return true;
+	}), config.inferenceThreads, config.inferenceThreads*2, pinOther);
 
-	return filePaths;
+	pipeline.addStage("element", accounted([elementYolos](Job& job) -> bool
+	{
+		if(job.cached)
+			return true;
+		Yolo5Pool::Lease yolo = elementYolos->checkout(Placement::currentNode());
+		job.document->detectElements(yolo.get());
+		return true;
+	}), config.inferenceThreads, config.inferenceThreads*2, pinElement);
+
+	pipeline.addStage("parse", accounted([](Job& job) -> bool
+	{
+		if(!job.cached)
+			job.document->parseCircuts();
+		return true;
+	}), config.parseThreads, config.parseThreads*2, pinOther);
+
+	pipeline.addStage("save", accounted([&config, cache](Job& job) -> bool
+	{
+		if(cache && !job.cached)
+			cache->store(*job.document);
+		return save(job.document, config);
+	}), config.ioThreads, config.ioThreads*2, pinOther);
+}
+
+static volatile sig_atomic_t stopRequested = false;
+
+static void stopHandler(int signal)
+{
+	(void)signal;
+	stopRequested = true;
+}
+
+static void dropMessage(const std::string& message, void* userdata)
+{
+	(void)message;
+	(void)userdata;
+}
+
+static void setupThreads(Config& config)
+{
+	size_t cpus = availableCpus();
+	if(config.threads == 0)
+		config.threads = cpus;
+
+	//inference runs in two pools of inferenceThreads workers each, the page workers of the circut stage and the element stage
+	//the circut stage workers only wait for their pages and are not counted
+	size_t quarter = std::max<size_t>(config.threads/4, 1);
+	size_t eighth = std::max<size_t>(config.threads/8, 1);
+	if(config.loadThreads == 0)
+		config.loadThreads = quarter;
+	if(config.inferenceThreads == 0)
+		config.inferenceThreads = quarter;
+	if(config.parseThreads == 0)
+		config.parseThreads = eighth;
+	if(config.ioThreads == 0)
+		config.ioThreads = eighth;
+	if(config.replicas == 0)
+		config.replicas = config.inferenceThreads;
+
+	//opencvs thread pool is process global, it is sized so that the inference workers of both pools together
+	//use the cpus left over by the other stages instead of each of them claiming a share of all cpus
+	//pinned inference workers run opencv on their own cpu only as opencvs pool threads can not be placed
+	size_t otherThreads = config.loadThreads + config.parseThreads + config.ioThreads;
+	size_t inferenceCpus = config.threads > otherThreads ? config.threads - otherThreads : 1;
+	int cvThreads = config.pin ? 1 : std::max<size_t>(inferenceCpus/(2*config.inferenceThreads), 1);
+	cv::setNumThreads(config.pin ? 0 : cvThreads);
+
+	Log(Log::INFO)<<"Detected "<<cpus<<" usable cpus (hardware concurrency "<<std::thread::hardware_concurrency()
+		<<", affinity "<<affinityCpus()<<", cgroup quota "<<cgroupCpus()<<")";
+	Log(Log::INFO)<<"Using "<<config.threads<<" threads: "<<config.loadThreads<<" load, "
+		<<config.inferenceThreads<<" inference per network stage ("<<cvThreads<<" opencv threads), "
+		<<config.parseThreads<<" parse, "<<config.ioThreads<<" io";
 }
 
 static bool checkParams(Config& config)
 {
-	if(config.circutNetworkFileName.empty())
-		Log(Log::INFO)<<"Internal circut network will be used";
-	if(config.elementNetworkFileName.empty())
-		Log(Log::INFO)<<"Internal element network will be used";
-	if(config.graphNetworkFileName.empty())
-		Log(Log::WARN)<<"a graph network file name is not provided, wont be able to extract graphs";
+	//merging only reads statistics, no networks are involved
+	if(!config.merge)
+	{
+		if(config.circutNetworkFileName.empty())
+			Log(Log::INFO)<<"Internal circut network will be used";
+		if(config.elementNetworkFileName.empty())
+			Log(Log::INFO)<<"Internal element network will be used";
+		if(config.graphNetworkFileName.empty())
+			Log(Log::WARN)<<"a graph network file name is not provided, wont be able to extract graphs";
+	}
 
 	if(config.outDir.empty())
 	{
@@ -130,12 +392,18 @@ static bool checkParams(Config& config)
 		}
 	}
 
-	if(config.paths.empty())
+	if(config.paths.empty() && config.filesFrom.empty() && config.daemon.empty())
 	{
 		Log(Log::ERROR)<<"path(s) to pdf a file(s) or a directory with pdf files must be provided";
 		return false;
 	}
 
+	if(config.embeddedImages && config.outputCircutLabels)
+	{
+		Log(Log::ERROR)<<"Circut labels refer to rendered pages and can not be saved with --embedded-images";
+		return false;
+	}
+
 	if(config.baysenFileName.empty() && !config.wordFileName.empty())
 	{
 		Log(Log::ERROR)<<"For document classification both a parameter file must be provided";
@@ -151,96 +419,27 @@ static bool checkParams(Config& config)
 	return true;
 }
 
-size_t removeLessThanN(std::map<std::string, size_t, CompString>& map, size_t n)
+static bool outputStatistics(const Statistics& statistics, const Config& config, bool quiet = false)
 {
-	size_t otherCount = 0;
-	for(const std::pair<std::string, size_t> circut : map)
-	{
-		if(circut.second < n)
-			otherCount += circut.second;
-	}
-	std::erase_if(map, [n](const std::pair<std::string, size_t>& circut)->bool{return circut.second < n;});
-
-	return otherCount;
+	bool ret = statistics.saveReport(config.outDir/"statistics.txt", quiet);
+	ret = statistics.savePartial(config.outDir/"statistics.part") && ret;
+	return ret;
 }
 
-bool outputStatistics(const std::vector<std::shared_ptr<Document>>& documents, const Config& config)
+static int mergeStatistics(const Config& config)
 {
-	std::map<std::string, size_t, CompString> allCircutMap;
-	std::map<std::string, std::map<std::string, size_t, CompString>, CompString> fields;
-
-	for(const std::shared_ptr<Document>& document : documents)
-		fields.insert({document->getField(), std::map<std::string, size_t, CompString>()});
-
-	Log(Log::INFO)<<"Found "<<fields.size()<<" fields:";
-	for(const std::pair<std::string, std::map<std::string, size_t, CompString>> field : fields)
-		Log(Log::INFO)<<field.first;
-
-	Log(Log::INFO)<<"Calculating statistics";
-	for(const std::shared_ptr<Document>& document : documents)
-	{
-		for(Circut& circut : document->circuts)
-		{
-			std::string circutStr = circut.getString();
-
-			if(circutStr.find("s") != std::string::npos || circutStr.find("x") != std::string::npos)
-				continue;
-
-			std::map<std::string, size_t, CompString>& fieldMap = fields.at(document->getField());
-
-			auto fieldMapIterator = fieldMap;
-			if(fieldMap.find(circutStr) == fieldMap.end())
-				fieldMap.insert({circutStr, 1});
-			else
-				++fieldMap.at(circutStr);
-
-			auto iterator = allCircutMap.find(circutStr);
-			if(iterator == allCircutMap.end())
-				allCircutMap.insert({circutStr, 1});
-			else
-				++allCircutMap.at(circutStr);
-		}
-	}
-
-	size_t allCircutOtherCount = removeLessThanN(allCircutMap, 3);
-
-	Log(Log::INFO)<<"Saveing statistics to "<<config.outDir/"statistics.txt";
-	std::fstream file;
-	file.open(config.outDir/"statistics.txt", std::ios_base::out);
-	if(!file.is_open())
-	{
-		Log(Log::ERROR)<<"Could not open "<<config.outDir/"statistics.txt"<<" for writeing";
-		return false;
-	}
-	if(fields.size() > 1)
-		file<<"All circuts:\n";
-	size_t i = 0;
-	for(const std::pair<std::string, size_t> circut : allCircutMap)
-	{
-		file<<i<<",\t"<<circut.second<<",\t"<<circut.first<<'\n';
-		++i;
-	}
-	file<<i<<",\t"<<allCircutOtherCount<<",\tother\n\n";
-
-	if(fields.size() > 1)
+	Statistics statistics;
+	for(const std::filesystem::path& path : config.paths)
 	{
-		i = 0;
-		for(std::pair<std::string, std::map<std::string, size_t, CompString>> field : fields)
-		{
-			size_t otherCount = removeLessThanN(field.second, 3);
-			file<<field.first<<":\n";
-			for(const std::pair<std::string, size_t> circut : field.second)
-			{
-				file<<i<<",\t"<<circut.second<<",\t"<<circut.first<<'\n';
-				++i;
-			}
-			file<<i<<",\t"<<otherCount<<",\tother\n\n";
-		}
+		std::filesystem::path partialPath = path;
+		if(std::filesystem::is_directory(path))
+			partialPath = path/"statistics.part";
+		Log(Log::INFO)<<"Merging "<<partialPath;
+		if(!statistics.loadPartial(partialPath))
+			return 3;
 	}
-	file<<'\n';
-	file.close();
-
-	return true;
+	Log(Log::INFO)<<"Merged statistics of "<<statistics.getDocumentCount()<<" documents";
+	return outputStatistics(statistics, config) ? 0 : 3;
 }
 
 int main(int argc, char** argv)
@@ -254,42 +453,88 @@ int main(int argc, char** argv)
 	if(!checkParams(config))
 		return 1;
 
+	if(config.merge)
+		return mergeStatistics(config);
+
+	//in stdio daemon mode stdout carries the responses, everything else is logged to stderr
+	int resultFd = STDOUT_FILENO;
+	if(config.daemon == "-")
+	{
+		std::cout.flush();
+		resultFd = dup(STDOUT_FILENO);
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+	}
+	if(!config.daemon.empty())
+		signal(SIGPIPE, SIG_IGN);
+
+	//progress json lines need a stream of their own, log lines are written piecewise and would split them
+	int progressFd = -1;
+	if(!config.progressFile.empty())
+	{
+		progressFd = open(config.progressFile.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+		if(progressFd < 0)
+		{
+			Log(Log::ERROR)<<"Could not open "<<config.progressFile<<": "<<strerror(errno);
+			return 1;
+		}
+	}
+	else if(config.daemon != "-" && !isatty(STDOUT_FILENO))
+	{
+		//stdout is left to the progress json, everything else is logged to stderr
+		std::cout.flush();
+		progressFd = dup(STDOUT_FILENO);
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+	}
+
+	setupThreads(config);
+
 	poppler::set_debug_error_function(dropMessage, nullptr);
 
-	Yolo5* circutYolo;
-	Yolo5* elementYolo;
-	Yolo5* graphYolo = nullptr;
+	Placement placement;
+	Yolo5Pool::Placer placer;
+	if(config.pin)
+	{
+		//one cpu for every page worker and every element stage worker
+		placement.plan(config.inferenceThreads*2);
+		placement.report();
+		placer = [&placement](size_t replica){return placement.pinReplica(replica);};
+	}
+
+	std::unique_ptr<Yolo5Pool> circutYolos;
+	std::unique_ptr<Yolo5Pool> elementYolos;
+	std::unique_ptr<Yolo5Pool> graphYolos;
 
 	try
 	{
+		Log(Log::INFO)<<"Loading "<<config.replicas<<" replicas of each network";
 		if(config.circutNetworkFileName.empty())
 		{
 			size_t length;
 			const char* data = res::circutNetwork(length);
-			circutYolo = new Yolo5(length, data, 1);
+			circutYolos = std::make_unique<Yolo5Pool>(length, data, 1, config.replicas, placer);
 		}
 		else
 		{
 			Log(Log::DEBUG)<<"Reading circut network from "<<config.circutNetworkFileName;
-			circutYolo = new Yolo5(config.circutNetworkFileName, 1);
+			circutYolos = std::make_unique<Yolo5Pool>(config.circutNetworkFileName, 1, config.replicas, placer);
 		}
 
 		if(config.elementNetworkFileName.empty())
 		{
 			size_t length;
 			const char* data = res::elementNetwork(length);
-			elementYolo = new Yolo5(length, data, 7);
+			elementYolos = std::make_unique<Yolo5Pool>(length, data, 7, config.replicas, placer);
 		}
 		else
 		{
-			Log(Log::DEBUG)<<"Reading circut network from "<<config.circutNetworkFileName;
-			elementYolo = new Yolo5(config.elementNetworkFileName, 7);
+			Log(Log::DEBUG)<<"Reading element network from "<<config.elementNetworkFileName;
+			elementYolos = std::make_unique<Yolo5Pool>(config.elementNetworkFileName, 7, config.replicas, placer);
 		}
 
 		if(!config.graphNetworkFileName.empty())
 		{
-			graphYolo = new Yolo5(config.graphNetworkFileName, 1);
-			Log(Log::DEBUG)<<"Red element network from "<<config.graphNetworkFileName;
+			graphYolos = std::make_unique<Yolo5Pool>(config.graphNetworkFileName, 1, config.replicas, placer);
+			Log(Log::DEBUG)<<"Red graph network from "<<config.graphNetworkFileName;
 		}
 	}
 	catch(const cv::Exception& ex)
@@ -314,6 +559,22 @@ int main(int argc, char** argv)
 			return 4;
 		}
 	}
+	if(config.outputCircutLabels && !std::filesystem::is_directory(config.outDir/"circutLabels"))
+	{
+		if(!std::filesystem::create_directory(config.outDir/"circutLabels"))
+		{
+			Log(Log::ERROR)<<config.outDir/"circutLabels"<<" is not a directory and a directory could not be created at this location";
+			return 4;
+		}
+	}
+	if(config.outputElementLabels && !std::filesystem::is_directory(config.outDir/"elementLabels"))
+	{
+		if(!std::filesystem::create_directory(config.outDir/"elementLabels"))
+		{
+			Log(Log::ERROR)<<config.outDir/"elementLabels"<<" is not a directory and a directory could not be created at this location";
+			return 4;
+		}
+	}
 
 	if(Log::level == Log::SUPERDEBUG)
 	{
@@ -321,66 +582,274 @@ int main(int argc, char** argv)
 		cv::resizeWindow("Viewer", 960, 500);
 	}
 
-	std::vector<std::shared_future<std::shared_ptr<Document>>> futures;
-	futures.reserve(THREADS);
+	MemoryBudget budget(config.memoryBudget);
+	if(config.memoryBudget > 0)
+	{
+		budget.reserveFixed(circutYolos->size()*circutYolos->checkout()->inputBytes());
+		budget.reserveFixed(elementYolos->size()*elementYolos->checkout()->inputBytes());
+		if(graphYolos)
+			budget.reserveFixed(graphYolos->size()*graphYolos->checkout()->inputBytes());
+		Log(Log::INFO)<<"Memory budget "<<config.memoryBudget/(1024*1024)<<" MiB, "
+			<<budget.getUsed()/(1024*1024)<<" MiB used by network inputs";
+	}
 
-	const std::vector<std::filesystem::path> files = toFilePaths(config.paths);
+	std::unique_ptr<ResultCache> cache;
+	if(!config.cacheDir.empty())
+	{
+		uint64_t modelHash = fnv1a(&RESULTS_VERSION, sizeof(RESULTS_VERSION));
+		uint64_t optionsHash = loadOptions(config).hash();
+		modelHash = fnv1a(&optionsHash, sizeof(optionsHash), modelHash);
+		//skipped pages change results, audit mode does not
+		bool triageSkips = config.triage == TRIAGE_ON;
+		modelHash = fnv1a(&triageSkips, sizeof(triageSkips), modelHash);
+		for(Yolo5Pool* pool : {circutYolos.get(), elementYolos.get(), graphYolos.get()})
+		{
+			uint64_t networkHash = pool ? pool->getNetworkHash() : 0;
+			modelHash = fnv1a(&networkHash, sizeof(networkHash), modelHash);
+		}
+		cache = std::make_unique<ResultCache>(config.cacheDir, modelHash);
+		if(!cache->open())
+			return 4;
+		Log(Log::INFO)<<"Using result cache at "<<cache->getDirectory();
+	}
 
-	std::vector<std::shared_ptr<Document>> documents;
+	Journal journal;
+	if(!journal.open(config.outDir/"journal.tsv", config.resume))
+		return 4;
 
-	for(size_t i = 0; i < files.size();)
+	FileEnumerator enumerator(config.paths, config.filesFrom);
+	if(!enumerator.open())
+		return 1;
+
+	CostHistory costHistory;
+	costHistory.open(config.outDir/"costs.tsv");
+
+	//sharding and cost ordering need to see every file, otherwise files are fed to the pipeline as they are found
+	bool prescan = config.shardCount > 1 || config.largestFirst;
+	std::vector<std::filesystem::path> scheduledFiles;
+	if(prescan)
 	{
-		while(i < files.size() && futures.size() < THREADS)
+		std::filesystem::path path;
+		while(enumerator.next(path))
+			scheduledFiles.push_back(path);
+		//the history differs between nodes so shards are balanced on the estimate alone to stay identical everywhere
+		if(config.shardCount > 1)
+			scheduledFiles = selectShard(estimateCosts(scheduledFiles, nullptr, config.pages, config.loadThreads), config.shardIndex, config.shardCount);
+		if(config.largestFirst)
+			scheduledFiles = orderByCost(estimateCosts(scheduledFiles, &costHistory, config.pages, config.loadThreads));
+	}
+	std::atomic<size_t> discovered = 0;
+
+	WorkStealingPool pageWorkers(config.inferenceThreads, [&placement](size_t worker){placement.pinInference(worker);});
+	//the main thread only enumerates and feeds the pipeline
+	placement.pinOther();
+
+	//documents are folded into the statistics as they finish so that none are kept alive until the end
+	Statistics statistics;
+	//documents skipped on resume are not processed again, their counts come from the statistics of the previous run
+	if(config.resume && config.outputStatistics)
+	{
+		std::filesystem::path partialPath = config.outDir/"statistics.part";
+		size_t journalDone = journal.count(Journal::STATUS_DONE);
+		if(std::filesystem::exists(partialPath))
 		{
-			futures.push_back(std::async(std::launch::async, Document::load, files[i]));
-			Log(Log::INFO)<<"Loading document "<<i<<" of "<< files.size();
-			++i;
+			if(!statistics.loadPartial(partialPath))
+				return 3;
+			Log(Log::INFO)<<"Resumed statistics of "<<statistics.getDocumentCount()<<" documents from "<<partialPath;
 		}
+		//documents are only journaled as done once a snapshot contains them, so the two only differ after a crash between writeing both
+		if(statistics.getDocumentCount() != journalDone)
+			Log(Log::WARN)<<"The journal records "<<journalDone<<" finished documents but the statistics contain "
+				<<statistics.getDocumentCount()<<", the statistics will be off by the difference";
+	}
+	//finished documents not yet in a statistics snapshot, journaled as done once one is written
+	std::vector<std::pair<std::filesystem::path, uint64_t>> unsnapshotted;
+	auto snapshotStatistics = [&](bool quiet) -> bool
+	{
+		if(!outputStatistics(statistics, config, quiet))
+			return false;
+		for(const std::pair<std::filesystem::path, uint64_t>& document : unsnapshotted)
+			journal.record(document.first, Journal::STATUS_DONE, document.second);
+		unsnapshotted.clear();
+		return true;
+	};
+	std::chrono::steady_clock::time_point lastSnapshot = std::chrono::steady_clock::now();
+	std::mutex sinkMutex;
+	size_t finished = 0;
+	Metrics::Counter& documentsDone = Metrics::global().counter("documents_done");
+	Metrics::Counter& documentsFailed = Metrics::global().counter("documents_failed");
+	Metrics::Counter& documentsCached = Metrics::global().counter("documents_cached");
+	Progress progress(std::chrono::seconds(config.progressInterval), progressFd);
+
+	Pipeline pipeline([&](Job& job, bool completed)
+	{
+		if(job.done)
+			job.done(job, completed);
 
-		while(futures.size() >= THREADS)
+		if(job.document && completed)
 		{
-			for(size_t j = 0; j < futures.size(); ++j)
+			if(!job.cached)
+				costHistory.record(job.path, std::chrono::duration<double>(job.processingTime).count());
+			documentsDone.add();
+			progress.documentDone(job.pages, job.document->circuts.size(), config.triage == TRIAGE_ON ? job.document->triagedPages() : 0);
+		}
+		else
+		{
+			documentsFailed.add();
+			progress.documentFailed(job.failedStage.empty() ? "unkown" : job.failedStage);
+		}
+		if(job.cached)
+			documentsCached.add();
+
+		std::scoped_lock lock(sinkMutex);
+		++finished;
+		if(!job.document)
+			journal.record(job.path, Journal::STATUS_FAILED, 0);
+		else if(completed && config.outputStatistics)
+			unsnapshotted.push_back({job.path, job.document->getContentHash()});
+		else
+			journal.record(job.path, completed ? Journal::STATUS_DONE : Journal::STATUS_ERROR, job.document->getContentHash());
+
+		if(!job.document)
+		{
+			Log(Log::WARN)<<"Failed to load document "<<job.path<<". "<<finished<<" of "<<discovered<<" done";
+			return;
+		}
+
+		if(completed)
+			Log(Log::INFO)<<"Finished document "<<job.path<<". "<<finished<<" of "<<discovered<<" done";
+		else
+			Log(Log::WARN)<<"Failed to process document "<<job.path<<". "<<finished<<" of "<<discovered<<" done";
+
+		//documents that failed are processed again on resume and counted then
+		if(config.outputStatistics && completed)
+		{
+			statistics.addDocument(*job.document);
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			if(now - lastSnapshot >= std::chrono::seconds(config.statisticsInterval))
 			{
-				if(futures[j].wait_for(std::chrono::microseconds(0)) == std::future_status::ready)
-				{
-					std::shared_ptr<Document> document = futures[j].get();
-					if(document)
-					{
-						process(document, circutYolo, elementYolo, graphYolo, config);
-						if(config.outputStatistics)
-							documents.push_back(document);
-						Log(Log::INFO)<<"Finished document. documents in queue: "<<futures.size();
-					}
-					else
-					{
-						Log(Log::WARN)<<"Failed to load document. documents in qeue: "<<futures.size();
-					}
-					futures.erase(futures.begin()+j);
-				}
+				lastSnapshot = now;
+				snapshotStatistics(true);
 			}
 		}
+	});
+
+	Workers workers;
+	workers.pageWorkers = &pageWorkers;
+	workers.circutYolos = circutYolos.get();
+	workers.elementYolos = elementYolos.get();
+	workers.graphYolos = graphYolos.get();
+	workers.budget = &budget;
+	workers.cache = cache.get();
+	workers.placement = &placement;
+	//cached results carry no images
+	workers.cacheLookups = !config.outputCircut && !config.outputCircutLabels && !config.outputElementLabels;
+	if(cache && !workers.cacheLookups)
+		Log(Log::WARN)<<"Image outputs requested, the result cache will only be written to";
+
+	addStages(pipeline, workers, config);
+	pipeline.start();
+
+	if(!config.metricsFile.empty())
+	{
+		Metrics& metrics = Metrics::global();
+		for(size_t i = 0; i < pipeline.stageCount(); ++i)
+			metrics.setGauge("queue_depth_" + pipeline.stageName(i), [&pipeline, i](){return pipeline.queueDepth(i);});
+		metrics.setGauge("memory_used_bytes", [&budget](){return budget.getUsed();});
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		metrics.setGauge("documents_per_second", [&documentsDone, start]()
+		{
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			return seconds > 0 ? documentsDone.get()/seconds : 0;
+		});
+		Metrics::Format format = config.metricsFile.extension() == ".json" ? Metrics::FORMAT_JSON : Metrics::FORMAT_PROMETHEUS;
+		metrics.startExport(config.metricsFile, format, std::chrono::seconds(config.metricsInterval));
 	}
 
-	Log(Log::INFO)<<"Working on final documents";
+	struct sigaction action = {};
+	action.sa_handler = stopHandler;
+	action.sa_flags = SA_RESETHAND;
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+
+	if(prescan)
+		progress.setTotal(scheduledFiles.size(), true);
+	progress.start();
 
-	for(size_t j = 0; j < futures.size(); ++j)
+	size_t skipped = 0;
+	std::filesystem::path path;
+	if(!config.daemon.empty())
 	{
-		std::shared_ptr<Document> document = futures[j].get();
-		if(document)
+		Daemon daemon([&](Job job)
+		{
+			progress.setTotal(++discovered, false);
+			pipeline.push(std::move(job));
+		}, &stopRequested);
+		bool ret = config.daemon == "-" ? daemon.serveStdio(resultFd) : daemon.serveSocket(config.daemon);
+		if(!ret)
+			stopRequested = true;
+	}
+	for(size_t i = 0; !stopRequested && config.daemon.empty(); ++i)
+	{
+		if(prescan)
+		{
+			if(i >= scheduledFiles.size())
+				break;
+			path = scheduledFiles[i];
+		}
+		else if(!enumerator.next(path))
+		{
+			break;
+		}
+		++discovered;
+		if(!prescan)
+			progress.setTotal(discovered, false);
+
+		if(config.resume && journal.isComplete(path))
 		{
-			process(document, circutYolo, elementYolo, graphYolo, config);
-			if(config.outputStatistics)
-				documents.push_back(document);
+			progress.documentSkipped();
+			std::scoped_lock lock(sinkMutex);
+			++skipped;
+			++finished;
+			continue;
 		}
-		Log(Log::INFO)<<"Finished document";
+
+		Job job;
+		job.path = path;
+		job.index = i;
+		pipeline.push(std::move(job));
+	}
+
+	if(config.daemon.empty())
+		progress.setTotal(discovered, true);
+
+	if(skipped > 0)
+		Log(Log::INFO)<<"Skipped "<<skipped<<" files already processed according to the journal";
+
+	if(stopRequested)
+		Log(Log::WARN)<<"Stop requested, finishing documents already in progress. Signal again to abort";
+
+	Log(Log::INFO)<<"Working on final documents";
+	pipeline.finish();
+	progress.finish();
+	//writes the final snapshot while everything the gauges refer to is still alive
+	Metrics::global().stopExport();
+
+	if(config.triage != TRIAGE_OFF)
+	{
+		Metrics& metrics = Metrics::global();
+		Log(Log::INFO)<<"Triage "<<(config.triage == TRIAGE_ON ? "skipped " : "would skip ")<<metrics.counter("triage_skipped_pages").get()
+			<<" of "<<metrics.counter("triage_pages").get()<<" pages: "<<metrics.counter("triage_text_pages").get()<<" text, "
+			<<metrics.counter("triage_photo_pages").get()<<" photo, "<<metrics.counter("triage_blank_pages").get()<<" blank";
+		if(config.triage == TRIAGE_AUDIT)
+			Log(Log::INFO)<<"Triage would miss "<<metrics.counter("triage_missed_circuts").get()<<" circuts on "
+				<<metrics.counter("triage_missed_pages").get()<<" pages";
 	}
 
-	delete circutYolo;
-	delete elementYolo;
-	if(graphYolo)
-		delete graphYolo;
+	if(cache)
+		Log(Log::INFO)<<"Result cache: "<<cache->getHits()<<" hits, "<<cache->getMisses()<<" misses, "<<cache->getStored()<<" stored";
 
-	if(config.outputStatistics && !outputStatistics(documents, config))
+	if(config.outputStatistics && !snapshotStatistics(false))
 		return 3;
 
 	return 0;
@@ -0,0 +1,87 @@
+#include "memorybudget.h"
+
+#include "log.h"
+
+MemoryBudget::Reservation::Reservation(Reservation&& in): budget(in.budget), bytes(in.bytes)
+{
+	in.budget = nullptr;
+	in.bytes = 0;
+}
+
+MemoryBudget::Reservation& MemoryBudget::Reservation::operator=(Reservation&& in)
+{
+	if(this != &in)
+	{
+		release();
+		budget = in.budget;
+		bytes = in.bytes;
+		in.budget = nullptr;
+		in.bytes = 0;
+	}
+	return *this;
+}
+
+MemoryBudget::Reservation::~Reservation()
+{
+	release();
+}
+
+void MemoryBudget::Reservation::resize(size_t bytesI)
+{
+	if(budget)
+		budget->adjust(bytes, bytesI, false);
+	bytes = bytesI;
+}
+
+void MemoryBudget::Reservation::release()
+{
+	if(budget)
+		budget->adjust(bytes, 0, true);
+	budget = nullptr;
+	bytes = 0;
+}
+
+MemoryBudget::MemoryBudget(size_t budgetI): budget(budgetI)
+{
+}
+
+MemoryBudget::Reservation MemoryBudget::reserve(size_t bytes)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	if(budget > 0 && bytes > budget)
+		Log(Log::WARN)<<"Reserveing "<<bytes/(1024*1024)<<" MiB which is larger than the entire memory budget";
+
+	//granting a reservation when no other is held guarantees progress
+	released.wait(lock, [this, bytes]{return budget == 0 || reservations == 0 || used + bytes <= budget;});
+	used += bytes;
+	++reservations;
+	return Reservation(this, bytes);
+}
+
+void MemoryBudget::reserveFixed(size_t bytes)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	used += bytes;
+}
+
+void MemoryBudget::adjust(size_t oldBytes, size_t newBytes, bool remove)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	used = used - oldBytes + newBytes;
+	if(remove)
+		--reservations;
+	lock.unlock();
+	if(newBytes < oldBytes || remove)
+		released.notify_all();
+}
+
+size_t MemoryBudget::getUsed() const
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return used;
+}
+
+size_t MemoryBudget::getBudget() const
+{
+	return budget;
+}
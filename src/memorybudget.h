@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <mutex>
+#include <condition_variable>
+
+class MemoryBudget
+{
+public:
+	class Reservation
+	{
+	private:
+		MemoryBudget* budget = nullptr;
+		size_t bytes = 0;
+
+	public:
+		Reservation() = default;
+		Reservation(MemoryBudget* budgetI, size_t bytesI): budget(budgetI), bytes(bytesI) {}
+		Reservation(Reservation&& in);
+		Reservation& operator=(Reservation&& in);
+		Reservation(const Reservation&) = delete;
+		Reservation& operator=(const Reservation&) = delete;
+		~Reservation();
+
+		//changes the amount of memory accounted to this reservation, never blocks
+		void resize(size_t bytesI);
+		void release();
+		size_t size() const {return bytes;}
+	};
+
+private:
+	size_t budget;
+	size_t used = 0;
+	size_t reservations = 0;
+	mutable std::mutex mutex;
+	std::condition_variable released;
+
+private:
+	void adjust(size_t oldBytes, size_t newBytes, bool remove);
+
+public:
+	//a budget of 0 means unlimited
+	explicit MemoryBudget(size_t budgetI = 0);
+
+	//blocks until bytes fit into the budget, a reservation is always granted if no other reservation is held
+	Reservation reserve(size_t bytes);
+	//memory that is accounted for the entire runtime of the program, like network input buffers
+	void reserveFixed(size_t bytes);
+	size_t getUsed() const;
+	size_t getBudget() const;
+};
@@ -0,0 +1,208 @@
+#include "metrics.h"
+
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+#include "json.h"
+#include "log.h"
+
+void Metrics::Histogram::observe(std::chrono::nanoseconds duration)
+{
+	double seconds = std::chrono::duration<double>(duration).count();
+	size_t bucket = 0;
+	while(bucket < BOUNDS.size() && seconds > BOUNDS[bucket])
+		++bucket;
+	++buckets[bucket];
+	++count;
+	sumNs += duration.count();
+}
+
+double Metrics::Histogram::getSum() const
+{
+	return sumNs/1e9;
+}
+
+uint64_t Metrics::Histogram::getCumulative(size_t bucket) const
+{
+	uint64_t cumulative = 0;
+	for(size_t i = 0; i <= bucket && i < buckets.size(); ++i)
+		cumulative += buckets[i];
+	return cumulative;
+}
+
+Metrics::~Metrics()
+{
+	stopExport();
+}
+
+Metrics& Metrics::global()
+{
+	static Metrics metrics;
+	return metrics;
+}
+
+Metrics::Counter& Metrics::counter(const std::string& name)
+{
+	std::scoped_lock lock(mutex);
+	std::unique_ptr<Counter>& counter = counters[name];
+	if(!counter)
+		counter = std::make_unique<Counter>();
+	return *counter;
+}
+
+Metrics::Histogram& Metrics::histogram(const std::string& name)
+{
+	std::scoped_lock lock(mutex);
+	std::unique_ptr<Histogram>& histogram = histograms[name];
+	if(!histogram)
+		histogram = std::make_unique<Histogram>();
+	return *histogram;
+}
+
+void Metrics::setGauge(const std::string& name, std::function<double()> sample)
+{
+	std::scoped_lock lock(mutex);
+	gauges[name] = sample;
+}
+
+void Metrics::removeGauge(const std::string& name)
+{
+	std::scoped_lock lock(mutex);
+	gauges.erase(name);
+}
+
+std::string Metrics::prometheus()
+{
+	std::stringstream ss;
+	const std::string prefix = "circutextractor_";
+	double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	ss<<"# TYPE "<<prefix<<"uptime_seconds gauge\n"<<prefix<<"uptime_seconds "<<uptime<<'\n';
+
+	for(const std::pair<const std::string, std::unique_ptr<Counter>>& counter : counters)
+	{
+		ss<<"# TYPE "<<prefix<<counter.first<<"_total counter\n";
+		ss<<prefix<<counter.first<<"_total "<<counter.second->get()<<'\n';
+	}
+
+	for(const std::pair<const std::string, std::function<double()>>& gauge : gauges)
+	{
+		ss<<"# TYPE "<<prefix<<gauge.first<<" gauge\n";
+		ss<<prefix<<gauge.first<<' '<<gauge.second()<<'\n';
+	}
+
+	for(const std::pair<const std::string, std::unique_ptr<Histogram>>& histogram : histograms)
+	{
+		const std::string name = prefix + histogram.first + "_seconds";
+		ss<<"# TYPE "<<name<<" histogram\n";
+		for(size_t i = 0; i < Histogram::BOUNDS.size(); ++i)
+			ss<<name<<"_bucket{le=\""<<Histogram::BOUNDS[i]<<"\"} "<<histogram.second->getCumulative(i)<<'\n';
+		ss<<name<<"_bucket{le=\"+Inf\"} "<<histogram.second->getCumulative(Histogram::BOUNDS.size())<<'\n';
+		ss<<name<<"_sum "<<histogram.second->getSum()<<'\n';
+		ss<<name<<"_count "<<histogram.second->getCount()<<'\n';
+	}
+	return ss.str();
+}
+
+std::string Metrics::json()
+{
+	std::stringstream ss;
+	double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	ss<<"{\"uptime\":"<<uptime<<",\"counters\":{";
+
+	bool first = true;
+	for(const std::pair<const std::string, std::unique_ptr<Counter>>& counter : counters)
+	{
+		ss<<(first ? "" : ",")<<jsonString(counter.first)<<':'<<counter.second->get();
+		first = false;
+	}
+
+	ss<<"},\"gauges\":{";
+	first = true;
+	for(const std::pair<const std::string, std::function<double()>>& gauge : gauges)
+	{
+		ss<<(first ? "" : ",")<<jsonString(gauge.first)<<':'<<gauge.second();
+		first = false;
+	}
+
+	ss<<"},\"histograms\":{";
+	first = true;
+	for(const std::pair<const std::string, std::unique_ptr<Histogram>>& histogram : histograms)
+	{
+		uint64_t count = histogram.second->getCount();
+		ss<<(first ? "" : ",")<<jsonString(histogram.first)<<":{\"count\":"<<count<<",\"sum\":"<<histogram.second->getSum()
+			<<",\"mean\":"<<(count > 0 ? histogram.second->getSum()/count : 0)<<",\"buckets\":[";
+		for(size_t i = 0; i < Histogram::BOUNDS.size(); ++i)
+			ss<<(i > 0 ? "," : "")<<"{\"le\":"<<Histogram::BOUNDS[i]<<",\"count\":"<<histogram.second->getCumulative(i)<<'}';
+		ss<<"]}";
+		first = false;
+	}
+	ss<<"}}\n";
+	return ss.str();
+}
+
+bool Metrics::save(const std::filesystem::path& path, Format format)
+{
+	std::string content;
+	{
+		std::scoped_lock lock(mutex);
+		content = format == FORMAT_JSON ? json() : prometheus();
+	}
+
+	//scrapers may read the file at any time so it is replaced atomically
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp";
+	std::fstream file(tempPath, std::ios_base::out | std::ios_base::trunc);
+	if(!file.is_open())
+	{
+		Log(Log::WARN)<<"Could not open "<<tempPath<<" for writeing";
+		return false;
+	}
+	file<<content;
+	file.close();
+
+	std::error_code ec;
+	if(file.fail())
+	{
+		std::filesystem::remove(tempPath, ec);
+		Log(Log::WARN)<<"Could not write metrics to "<<tempPath;
+		return false;
+	}
+	std::filesystem::rename(tempPath, path, ec);
+	if(ec)
+	{
+		Log(Log::WARN)<<"Could not move metrics to "<<path<<": "<<ec.message();
+		return false;
+	}
+	return true;
+}
+
+void Metrics::exportLoop(std::filesystem::path path, Format format, std::chrono::seconds interval)
+{
+	std::unique_lock lock(exportMutex);
+	while(!exportStop)
+	{
+		exportWake.wait_for(lock, interval, [this](){return exportStop;});
+		lock.unlock();
+		save(path, format);
+		lock.lock();
+	}
+}
+
+void Metrics::startExport(const std::filesystem::path& path, Format format, std::chrono::seconds interval)
+{
+	stopExport();
+	exportStop = false;
+	exportThread = std::thread(&Metrics::exportLoop, this, path, format, interval);
+}
+
+void Metrics::stopExport()
+{
+	{
+		std::scoped_lock lock(exportMutex);
+		exportStop = true;
+	}
+	exportWake.notify_all();
+	if(exportThread.joinable())
+		exportThread.join();
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <memory>
+#include <cstdint>
+#include <functional>
+#include <filesystem>
+#include <condition_variable>
+
+//process wide counters, gauges and latency histograms that are periodically exported for monitoring
+class Metrics
+{
+public:
+	class Counter
+	{
+	private:
+		std::atomic<uint64_t> value = 0;
+
+	public:
+		void add(uint64_t count = 1) {value += count;}
+		uint64_t get() const {return value;}
+	};
+
+	class Histogram
+	{
+	public:
+		//upper bounds of the buckets in seconds, an implicit +Inf bucket follows
+		static constexpr std::array<double, 14> BOUNDS = {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30};
+
+	private:
+		std::array<std::atomic<uint64_t>, BOUNDS.size()+1> buckets = {};
+		std::atomic<uint64_t> count = 0;
+		std::atomic<uint64_t> sumNs = 0;
+
+	public:
+		void observe(std::chrono::nanoseconds duration);
+		uint64_t getCount() const {return count;}
+		double getSum() const;
+		//cumulative count of observations less than or equal to BOUNDS[bucket]
+		uint64_t getCumulative(size_t bucket) const;
+	};
+
+	//measures the lifetime of the timer
+	class Timer
+	{
+	private:
+		Histogram& histogram;
+		std::chrono::steady_clock::time_point start;
+
+	public:
+		explicit Timer(Histogram& histogramI): histogram(histogramI), start(std::chrono::steady_clock::now()) {}
+		~Timer() {histogram.observe(std::chrono::steady_clock::now() - start);}
+		Timer(const Timer&) = delete;
+		Timer& operator=(const Timer&) = delete;
+	};
+
+	enum Format
+	{
+		FORMAT_PROMETHEUS = 0,
+		FORMAT_JSON,
+	};
+
+private:
+	std::map<std::string, std::unique_ptr<Counter>> counters;
+	std::map<std::string, std::unique_ptr<Histogram>> histograms;
+	std::map<std::string, std::function<double()>> gauges;
+	std::mutex mutex;
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	std::thread exportThread;
+	std::mutex exportMutex;
+	std::condition_variable exportWake;
+	bool exportStop = false;
+
+private:
+	Metrics() = default;
+	std::string prometheus();
+	std::string json();
+	void exportLoop(std::filesystem::path path, Format format, std::chrono::seconds interval);
+
+public:
+	~Metrics();
+	Metrics(const Metrics&) = delete;
+	Metrics& operator=(const Metrics&) = delete;
+
+	static Metrics& global();
+
+	//the returned references stay valid for the lifetime of the program, callers are expected to look them up once
+	Counter& counter(const std::string& name);
+	Histogram& histogram(const std::string& name);
+	//gauges are sampled when the metrics are exported
+	void setGauge(const std::string& name, std::function<double()> sample);
+	void removeGauge(const std::string& name);
+
+	bool save(const std::filesystem::path& path, Format format);
+	//rewrites path every interval until stopExport is called, which writes a final snapshot
+	void startExport(const std::filesystem::path& path, Format format, std::chrono::seconds interval);
+	void stopExport();
+};
@@ -4,13 +4,45 @@
 #include <argp.h>
 #include <iostream>
 #include <filesystem>
+#include <stdexcept>
 #include "log.h"
+#include "pagesource.h"
+#include "triage.h"
 
 const char *argp_program_version = "1.0";
 const char *argp_program_bug_address = "<carl@uvos.xyz>";
 static char doc[] = "Application detects EIS circuts and EIS graphs in pdf files";
 static char args_doc[] = "";
 
+enum
+{
+	OPT_REPLICAS = 256,
+	OPT_LOAD_THREADS,
+	OPT_INFERENCE_THREADS,
+	OPT_PARSE_THREADS,
+	OPT_IO_THREADS,
+	OPT_MEMORY_BUDGET,
+	OPT_RESUME,
+	OPT_CACHE,
+	OPT_SHARD,
+	OPT_MERGE,
+	OPT_STATISTICS_INTERVAL,
+	OPT_FILES_FROM,
+	OPT_DAEMON,
+	OPT_METRICS,
+	OPT_METRICS_INTERVAL,
+	OPT_PROGRESS_INTERVAL,
+	OPT_PROGRESS_FILE,
+	OPT_PIN,
+	OPT_LARGEST_FIRST,
+	OPT_GRAY,
+	OPT_PAGES,
+	OPT_RENDER_HANDLES,
+	OPT_EMBEDDED_IMAGES,
+	OPT_TRIAGE,
+	OPT_DETECT_SIDE,
+};
+
 static struct argp_option options[] =
 {
   {"verbose",			'v', 0,				0,	"Show debug messages" },
@@ -26,6 +58,32 @@ static struct argp_option options[] =
   {"statistics", 		't', 0,				0,	"Save statistics"},
   {"words", 			'w', "[FILE]",		0,	"Dictionary of words to use for baysen paper catigorization"},
   {"baysen", 			'b', "[FILE]",		0,	"Baysen classifier parameters"},
+  {"threads",			'j', "[COUNT]",			0,	"Number of worker threads, defaults to the number of usable cpus"},
+  {"load-threads",		OPT_LOAD_THREADS, "[COUNT]",		0,	"Number of threads loading and rendering documents"},
+  {"inference-threads",	OPT_INFERENCE_THREADS, "[COUNT]",	0,	"Number of threads running each network"},
+  {"parse-threads",		OPT_PARSE_THREADS, "[COUNT]",	0,	"Number of threads parseing circuts"},
+  {"io-threads",		OPT_IO_THREADS, "[COUNT]",		0,	"Number of threads saveing output files"},
+  {"replicas",			OPT_REPLICAS, "[COUNT]",	0,	"Number of copies of each network to load for parallel inference, defaults to the number of inference threads"},
+  {"memory-budget",		OPT_MEMORY_BUDGET, "[SIZE]",	0,	"Limit for memory used by documents in flight in MiB, K, M and G suffixes are accepted"},
+  {"resume",			OPT_RESUME, 0,		0,	"Skip files recorded as processed in the journal of the output directory"},
+  {"cache",			OPT_CACHE, "[DIRECTORY]",	0,	"Directory of a result cache, may be shared between runs and machines"},
+  {"shard",			OPT_SHARD, "[INDEX/COUNT]",	0,	"Only process the files of shard INDEX (starting at 0) out of COUNT shards, balanced on the number of selected pages and the file size. Every node opens every input file to count its pages"},
+  {"merge",			OPT_MERGE, 0,		0,	"Merge the statistics of the output directories or statistics.part files given as paths"},
+  {"statistics-interval",	OPT_STATISTICS_INTERVAL, "[SECONDS]",	0,	"Rewrite the statistics every SECONDS while running, default 60"},
+  {"files-from",		OPT_FILES_FROM, "[FILE]",	0,	"Also process the files and directories listed in FILE, one per line or NUL separated, - reads stdin"},
+  {"daemon",			OPT_DAEMON, "[SOCKET]",	0,	"Keep running and process documents requested as json lines on the unix socket SOCKET, - uses stdin and stdout"},
+  {"metrics",			OPT_METRICS, "[FILE]",	0,	"Periodically write throughput and latency metrics to FILE, as json if FILE ends in .json otherwise in prometheus text format"},
+  {"metrics-interval",	OPT_METRICS_INTERVAL, "[SECONDS]",	0,	"Rewrite the metrics every SECONDS, default 10"},
+  {"progress-interval",	OPT_PROGRESS_INTERVAL, "[SECONDS]",	0,	"Report progress every SECONDS, as json lines on stdout with the log moved to stderr if stdout is not a terminal, default 10"},
+  {"progress-file",		OPT_PROGRESS_FILE, "[FILE]",	0,	"Append progress as json lines to FILE instead of stdout"},
+  {"pin",			OPT_PIN, 0,			0,	"Pin inference workers and network replicas to cpus spread over the numa nodes, other workers to the remaining cpus"},
+  {"largest-first",		OPT_LARGEST_FIRST, 0,		0,	"Scan all files up front and process the most expensive ones first, refined by the times of previous runs"},
+  {"gray",			OPT_GRAY, 0,			0,	"Render and process pages as grayscale, uses a third of the memory for pages"},
+  {"pages",			OPT_PAGES, "[SELECTION]",	0,	"Pages to process: all, N for the first N pages or a list of pages and ranges like 1-3,7,10-, default 10"},
+  {"render-handles",		OPT_RENDER_HANDLES, "[COUNT]",	0,	"Render up to COUNT pages of a document concurrently, each with its own parsed copy of the pdf, default 1"},
+  {"embedded-images",		OPT_EMBEDDED_IMAGES, 0,	0,	"Detect on the raster figures embedded in a page at their native resolution, only pages without any are rendered"},
+  {"triage",			OPT_TRIAGE, "[MODE]",	OPTION_ARG_OPTIONAL,	"Skip pages that are blank, text only or photos before inference, MODE audit processes them anyway and reports the circuts triage would miss"},
+  {"detect-side",		OPT_DETECT_SIDE, "[PIXELS]",	0,	"Detect circuts and graphs on pages rendered with their longer side at PIXELS, like the 640 the networks use, and render only the detected regions at full resolution"},
   { 0 }
 };
 
@@ -43,8 +101,100 @@ struct Config
 	bool outputElementLabels = false;
 	bool outputSummaries = false;
 	bool outputStatistics = false;
+	size_t threads = 0;
+	size_t loadThreads = 0;
+	size_t inferenceThreads = 0;
+	size_t parseThreads = 0;
+	size_t ioThreads = 0;
+	size_t replicas = 0;
+	size_t memoryBudget = 0;
+	bool resume = false;
+	std::filesystem::path cacheDir;
+	size_t shardIndex = 0;
+	size_t shardCount = 1;
+	bool merge = false;
+	size_t statisticsInterval = 60;
+	std::filesystem::path filesFrom;
+	std::filesystem::path daemon;
+	std::filesystem::path metricsFile;
+	size_t metricsInterval = 10;
+	size_t progressInterval = 10;
+	std::filesystem::path progressFile;
+	bool pin = false;
+	bool largestFirst = false;
+	bool gray = false;
+	PageSelection pages;
+	size_t renderHandles = 1;
+	bool embeddedImages = false;
+	TriageMode triage = TRIAGE_OFF;
+	size_t detectSide = 0;
 };
 
+static bool parseCount(const char* arg, size_t& count)
+{
+	try
+	{
+		long long tmp = std::stoll(arg);
+		if(tmp < 1)
+			return false;
+		count = tmp;
+	}
+	catch(const std::logic_error& ex)
+	{
+		return false;
+	}
+	return true;
+}
+
+static bool parseSize(const char* arg, size_t& size)
+{
+	try
+	{
+		size_t pos;
+		long long tmp = std::stoll(arg, &pos);
+		if(tmp < 1)
+			return false;
+		std::string suffix(arg+pos);
+		size_t unit;
+		if(suffix.empty() || suffix == "M" || suffix == "m")
+			unit = 1024*1024;
+		else if(suffix == "K" || suffix == "k")
+			unit = 1024;
+		else if(suffix == "G" || suffix == "g")
+			unit = 1024*1024*1024;
+		else
+			return false;
+		size = tmp*unit;
+	}
+	catch(const std::logic_error& ex)
+	{
+		return false;
+	}
+	return true;
+}
+
+static bool parseShard(const char* arg, size_t& index, size_t& count)
+{
+	std::string str(arg);
+	size_t slash = str.find('/');
+	if(slash == std::string::npos)
+		return false;
+	try
+	{
+		long long indexTmp = std::stoll(str.substr(0, slash));
+		long long countTmp = std::stoll(str.substr(slash+1));
+		if(countTmp < 1 || indexTmp < 0 || indexTmp >= countTmp)
+			return false;
+		index = indexTmp;
+		count = countTmp;
+	}
+	catch(const std::logic_error& ex)
+	{
+		return false;
+	}
+	return true;
+}
+
 static error_t parse_opt (int key, char *arg, struct argp_state *state)
 {
 	Config *config = reinterpret_cast<Config*>(state->input);
@@ -90,6 +240,107 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 	case 'y':
 		config->outputElementLabels = true;
 		break;
+	case 'j':
+		if(!parseCount(arg, config->threads))
+			argp_error(state, "%s is not a valid thread count", arg);
+		break;
+	case OPT_LOAD_THREADS:
+		if(!parseCount(arg, config->loadThreads))
+			argp_error(state, "%s is not a valid thread count", arg);
+		break;
+	case OPT_INFERENCE_THREADS:
+		if(!parseCount(arg, config->inferenceThreads))
+			argp_error(state, "%s is not a valid thread count", arg);
+		break;
+	case OPT_PARSE_THREADS:
+		if(!parseCount(arg, config->parseThreads))
+			argp_error(state, "%s is not a valid thread count", arg);
+		break;
+	case OPT_IO_THREADS:
+		if(!parseCount(arg, config->ioThreads))
+			argp_error(state, "%s is not a valid thread count", arg);
+		break;
+	case OPT_REPLICAS:
+		if(!parseCount(arg, config->replicas))
+			argp_error(state, "%s is not a valid replica count", arg);
+		break;
+	case OPT_MEMORY_BUDGET:
+		if(!parseSize(arg, config->memoryBudget))
+			argp_error(state, "%s is not a valid size", arg);
+		break;
+	case OPT_RESUME:
+		config->resume = true;
+		break;
+	case OPT_CACHE:
+		config->cacheDir.assign(arg);
+		break;
+	case OPT_SHARD:
+		if(!parseShard(arg, config->shardIndex, config->shardCount))
+			argp_error(state, "%s is not a valid shard, expected INDEX/COUNT with INDEX < COUNT", arg);
+		break;
+	case OPT_STATISTICS_INTERVAL:
+		if(!parseCount(arg, config->statisticsInterval))
+			argp_error(state, "%s is not a valid interval", arg);
+		break;
+	case OPT_MERGE:
+		config->merge = true;
+		config->outputStatistics = true;
+		break;
+	case OPT_FILES_FROM:
+		config->filesFrom.assign(arg);
+		break;
+	case OPT_DAEMON:
+		config->daemon.assign(arg);
+		break;
+	case OPT_METRICS:
+		config->metricsFile.assign(arg);
+		break;
+	case OPT_METRICS_INTERVAL:
+		if(!parseCount(arg, config->metricsInterval))
+			argp_error(state, "%s is not a valid interval", arg);
+		break;
+	case OPT_PROGRESS_FILE:
+		config->progressFile.assign(arg);
+		break;
+	case OPT_PROGRESS_INTERVAL:
+		if(!parseCount(arg, config->progressInterval))
+			argp_error(state, "%s is not a valid interval", arg);
+		break;
+	case OPT_PIN:
+		config->pin = true;
+		break;
+	case OPT_LARGEST_FIRST:
+		config->largestFirst = true;
+		break;
+	case OPT_GRAY:
+		config->gray = true;
+		break;
+	case OPT_PAGES:
+		if(!PageSelection::parse(arg, config->pages))
+			argp_error(state, "%s is not a valid page selection", arg);
+		break;
+	case OPT_RENDER_HANDLES:
+		if(!parseCount(arg, config->renderHandles))
+			argp_error(state, "%s is not a valid handle count", arg);
+		break;
+	case OPT_EMBEDDED_IMAGES:
+		config->embeddedImages = true;
+		break;
+	case OPT_DETECT_SIDE:
+		if(!parseCount(arg, config->detectSide))
+			argp_error(state, "%s is not a valid size", arg);
+		//regions are rendered at the page size, detecting on larger renders would only cost time
+		else if(config->detectSide > static_cast<size_t>(PageSource::DEFAULT_LONG_SIDE))
+			argp_error(state, "%s is larger than the page size of %i", arg, PageSource::DEFAULT_LONG_SIDE);
+		break;
+	case OPT_TRIAGE:
+		if(!arg || std::string(arg) == "on")
+			config->triage = TRIAGE_ON;
+		else if(std::string(arg) == "audit")
+			config->triage = TRIAGE_AUDIT;
+		else
+			argp_error(state, "%s is not a valid triage mode, expected on or audit", arg);
+		break;
 	case ARGP_KEY_ARG:
 		config->paths.push_back(std::filesystem::path(arg));
 		break;
@@ -0,0 +1,289 @@
+#include "pagesource.h"
+
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <poppler-page.h>
+
+#include "hash.h"
+#include "tokenize.h"
+#include "log.h"
+
+PageSelection::PageSelection()
+{
+	ranges.push_back({0, DEFAULT_PAGES-1});
+}
+
+bool PageSelection::parse(const std::string& str, PageSelection& selection)
+{
+	std::vector<Range> ranges;
+	if(str == "all")
+	{
+		ranges.push_back({0, std::numeric_limits<size_t>::max()});
+	}
+	else if(!str.empty() && str.find_first_not_of("0123456789") == std::string::npos)
+	{
+		size_t count;
+		try
+		{
+			count = std::stoull(str);
+		}
+		catch(const std::logic_error& ex)
+		{
+			return false;
+		}
+		if(count == 0)
+			return false;
+		ranges.push_back({0, count-1});
+	}
+	else
+	{
+		std::vector<std::string> tokens = tokenize(str, ",");
+		for(const std::string& token : tokens)
+		{
+			size_t dash = token.find('-');
+			try
+			{
+				size_t first = std::stoull(token.substr(0, dash));
+				size_t last = first;
+				if(dash != std::string::npos)
+					last = dash+1 < token.size() ? std::stoull(token.substr(dash+1)) : std::numeric_limits<size_t>::max();
+				if(first == 0 || last < first)
+					return false;
+				ranges.push_back({first-1, last == std::numeric_limits<size_t>::max() ? last : last-1});
+			}
+			catch(const std::logic_error& ex)
+			{
+				return false;
+			}
+		}
+	}
+
+	if(ranges.empty())
+		return false;
+	selection.ranges = ranges;
+	return true;
+}
+
+std::vector<size_t> PageSelection::select(size_t pageCount) const
+{
+	std::vector<size_t> pages;
+	for(const Range& range : ranges)
+	{
+		for(size_t page = range.first; page <= range.last && page < pageCount; ++page)
+			pages.push_back(page);
+	}
+	std::sort(pages.begin(), pages.end());
+	pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+	return pages;
+}
+
+size_t PageSelection::count(size_t pageCount) const
+{
+	return select(pageCount).size();
+}
+
+uint64_t PageSelection::hash(uint64_t hash) const
+{
+	for(const Range& range : ranges)
+	{
+		hash = fnv1a(&range.first, sizeof(range.first), hash);
+		hash = fnv1a(&range.last, sizeof(range.last), hash);
+	}
+	return hash;
+}
+
+PageSource::PageSource(std::vector<char> dataI, const PageSelection& selection, int longSideI, bool grayI,
+					   bool withTextI, bool embeddedImages, size_t maxHandlesI, int detectLongSideI):
+data(std::move(dataI)), longSide(longSideI), detectLongSide(detectLongSideI), gray(grayI), withText(withTextI), maxHandles(std::max<size_t>(maxHandlesI, 1))
+{
+	//poppler does not copy the data, it has to stay valid as long as the document exists
+	document = poppler::document::load_from_raw_data(data.data(), data.size());
+	if(document)
+	{
+		pageNumbers = selection.select(document->pages());
+		handles.push_back(document);
+		idle.push_back(document);
+	}
+
+	if(document && embeddedImages)
+	{
+		embedded = std::make_unique<EmbeddedImages>(std::string_view(data.data(), data.size()));
+		//if the page tree was not understood figures can not be assigned to pages
+		if(embedded->pageCount() != static_cast<size_t>(document->pages()))
+		{
+			Log(Log::DEBUG)<<"Found "<<embedded->pageCount()<<" of "<<document->pages()<<" pages, rendering all pages";
+			embedded.reset();
+		}
+	}
+}
+
+PageSource::~PageSource()
+{
+	for(poppler::document* handle : handles)
+		delete handle;
+}
+
+poppler::document* PageSource::checkout()
+{
+	std::unique_lock lock(mutex);
+	handleReturned.wait(lock, [this](){return !idle.empty() || handles.size() < maxHandles;});
+	if(!idle.empty())
+	{
+		poppler::document* handle = idle.back();
+		idle.pop_back();
+		return handle;
+	}
+
+	//a poppler document may only be used by one thread at a time, further handles are only parsed once pages are rendered concurrently
+	poppler::document* handle = poppler::document::load_from_raw_data(data.data(), data.size());
+	if(!handle)
+	{
+		//fall back to waiting for the handles that exist
+		Log(Log::WARN)<<"Could not parse an additional handle of the document";
+		maxHandles = handles.size();
+		handleReturned.wait(lock, [this](){return !idle.empty();});
+		handle = idle.back();
+		idle.pop_back();
+		return handle;
+	}
+	handles.push_back(handle);
+	return handle;
+}
+
+void PageSource::checkin(poppler::document* handle)
+{
+	{
+		std::scoped_lock lock(mutex);
+		idle.push_back(handle);
+	}
+	handleReturned.notify_one();
+}
+
+size_t PageSource::count() const
+{
+	return pageNumbers.size();
+}
+
+size_t PageSource::pageNumber(size_t index) const
+{
+	return pageNumbers[index];
+}
+
+size_t PageSource::documentPages() const
+{
+	return document ? document->pages() : 0;
+}
+
+RenderedPage PageSource::render(size_t index, int renderLongSide)
+{
+	if(renderLongSide <= 0)
+		renderLongSide = longSide;
+
+	poppler::document* handle = checkout();
+	RenderedPage rendered;
+	{
+		std::unique_ptr<poppler::page> page(handle->create_page(pageNumbers[index]));
+		if(page)
+		{
+			poppler::page_renderer renderer;
+			setupRenderer(renderer, gray);
+			rendered = renderPage(renderer, page.get(), renderLongSide, gray);
+			if(withText)
+				rendered.text = page->text().to_latin1();
+		}
+	}
+	checkin(handle);
+
+	if(rendered.image.empty())
+		Log(Log::WARN)<<"Could not render page "<<pageNumbers[index];
+	rendered.number = pageNumbers[index];
+	rendered.scale = static_cast<double>(longSide)/renderLongSide;
+	return rendered;
+}
+
+RenderedPage PageSource::renderRegion(size_t pageNumber, const cv::Rect& region)
+{
+	poppler::document* handle = checkout();
+	RenderedPage rendered;
+	{
+		std::unique_ptr<poppler::page> page(handle->create_page(pageNumber));
+		if(page)
+		{
+			poppler::page_renderer renderer;
+			setupRenderer(renderer, gray);
+			rendered = renderPage(renderer, page.get(), longSide, gray, region);
+		}
+	}
+	checkin(handle);
+	rendered.number = pageNumber;
+	return rendered;
+}
+
+std::string PageSource::text(size_t index)
+{
+	poppler::document* handle = checkout();
+	std::string text;
+	{
+		std::unique_ptr<poppler::page> page(handle->create_page(pageNumbers[index]));
+		if(page)
+			text = page->text().to_latin1();
+	}
+	checkin(handle);
+	return text;
+}
+
+std::vector<RenderedPage> PageSource::images(size_t index)
+{
+	std::vector<RenderedPage> pages;
+	if(embedded && embedded->hasFigures(pageNumbers[index]))
+	{
+		for(const cv::Mat& figure : embedded->figures(pageNumbers[index], gray, longSide))
+		{
+			RenderedPage page;
+			page.image = figure;
+			page.number = pageNumbers[index];
+			pages.push_back(page);
+		}
+		if(!pages.empty() && withText)
+			pages[0].text = text(index);
+	}
+
+	//pages with only vector content, or figures that failed to decode, are rendered
+	if(pages.empty())
+		pages.push_back(render(index, detectLongSide));
+	return pages;
+}
+
+RenderedPage PageSource::renderPreview(size_t index, int previewLongSide, std::vector<cv::Rect>& textBoxes)
+{
+	poppler::document* handle = checkout();
+	RenderedPage rendered;
+	{
+		std::unique_ptr<poppler::page> page(handle->create_page(pageNumbers[index]));
+		if(page)
+		{
+			poppler::page_renderer renderer;
+			setupRenderer(renderer, true);
+			rendered = renderPage(renderer, page.get(), previewLongSide, true);
+
+			//text boxes are given in points
+			double scale = dpiForLongSide(page.get(), previewLongSide)/72.0;
+			for(const poppler::text_box& box : page->text_list())
+			{
+				poppler::rectf bbox = box.bbox();
+				textBoxes.push_back(cv::Rect(bbox.x()*scale, bbox.y()*scale,
+											 std::ceil(bbox.width()*scale), std::ceil(bbox.height()*scale)));
+			}
+		}
+	}
+	checkin(handle);
+	rendered.number = pageNumbers[index];
+	return rendered;
+}
+
+size_t PageSource::memoryUsage() const
+{
+	return data.capacity();
+}
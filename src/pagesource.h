@@ -0,0 +1,99 @@
+#pragma once
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <poppler-document.h>
+
+#include "popplertocv.h"
+#include "embeddedimages.h"
+
+//which pages of a document are processed
+class PageSelection
+{
+private:
+	struct Range
+	{
+		//0 based and inclusive
+		size_t first;
+		size_t last;
+	};
+
+	std::vector<Range> ranges;
+
+public:
+	static constexpr size_t DEFAULT_PAGES = 10;
+
+	//the first DEFAULT_PAGES pages
+	PageSelection();
+
+	//accepts all, a number N for the first N pages or a comma separated list of 1 based pages and ranges like 1-3,7,10-
+	static bool parse(const std::string& str, PageSelection& selection);
+
+	//0 based indices of the selected pages of a document with pageCount pages in ascending order
+	std::vector<size_t> select(size_t pageCount) const;
+	size_t count(size_t pageCount) const;
+	uint64_t hash(uint64_t hash) const;
+};
+
+//renders the selected pages of a pdf on demand so that only the pages currently being processed are held in memory
+//up to maxHandles pages are rendered concurrently, each by its own poppler document parsed from the same data
+class PageSource
+{
+private:
+	std::vector<char> data;
+	poppler::document* document = nullptr;
+	std::vector<size_t> pageNumbers;
+	int longSide;
+	//pages handed out for detection are rendered at this size if set, regions of them are rendered at longSide
+	int detectLongSide;
+	bool gray;
+	bool withText;
+	size_t maxHandles;
+	//only set if the figures embedded in the pdf are used instead of rendering pages
+	std::unique_ptr<EmbeddedImages> embedded;
+
+	//every handle ever created, document is the first one
+	std::vector<poppler::document*> handles;
+	std::vector<poppler::document*> idle;
+	std::mutex mutex;
+	std::condition_variable handleReturned;
+
+	poppler::document* checkout();
+	void checkin(poppler::document* handle);
+	std::string text(size_t index);
+
+public:
+	//long side pages are rendered at by default, regions detected on smaller renders are rendered at this size too
+	static constexpr int DEFAULT_LONG_SIDE = 1280;
+
+	//the pdf is parsed from data which is kept for the lifetime of the source
+	//if withTextI is set the text of a page is extracted from the same page object it is rendered from
+	//if embeddedImages is set pages that contain raster figures yield those instead of being rendered
+	PageSource(std::vector<char> dataI, const PageSelection& selection, int longSideI, bool grayI,
+			   bool withTextI = false, bool embeddedImages = false, size_t maxHandlesI = 1, int detectLongSideI = 0);
+	~PageSource();
+	PageSource(const PageSource&) = delete;
+	PageSource& operator=(const PageSource&) = delete;
+
+	bool isOpen() const {return document;}
+	//only valid while the source exists, not to be used concurrently with rendering
+	poppler::document* getDocument() {return document;}
+
+	//number of selected pages
+	size_t count() const;
+	size_t pageNumber(size_t index) const;
+	size_t documentPages() const;
+	//renderLongSide 0 renders at full resolution
+	RenderedPage render(size_t index, int renderLongSide = 0);
+	//renders region, given in pixels of a full resolution render, of the page with the pdf page number pageNumber
+	RenderedPage renderRegion(size_t pageNumber, const cv::Rect& region);
+	//the embedded figures of a page at no more than the page resolution, or the page rendered for detection if it has none
+	std::vector<RenderedPage> images(size_t index);
+	//renders a page in gray with its longer side at previewLongSide, textBoxes receives the text layer in pixels of that render
+	RenderedPage renderPreview(size_t index, int previewLongSide, std::vector<cv::Rect>& textBoxes);
+	//only the raw pdf is counted, rendered pages and the extra parsed handles are not
+	size_t memoryUsage() const;
+};
@@ -0,0 +1,115 @@
+#include "pipeline.h"
+
+#include <exception>
+#include <assert.h>
+
+#include "log.h"
+
+Pipeline::Pipeline(Sink sinkI): sink(sinkI)
+{
+}
+
+Pipeline::~Pipeline()
+{
+	finish();
+}
+
+void Pipeline::addStage(const std::string& name, StageFunction function, size_t workers, size_t queueSize, ThreadInit init)
+{
+	assert(!running);
+	if(workers == 0)
+		workers = 1;
+	stages.push_back(std::make_unique<Stage>(name, function, init, workers, queueSize));
+}
+
+void Pipeline::work(size_t stageIndex, size_t worker)
+{
+	Stage& stage = *stages[stageIndex];
+	if(stage.init)
+		stage.init(worker);
+
+	Job job;
+	while(stage.queue.pop(job))
+	{
+		bool ret;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		try
+		{
+			Metrics::Timer timer(stage.latency);
+			ret = stage.function(job);
+		}
+		catch(const std::exception& ex)
+		{
+			Log(Log::ERROR)<<"Stage "<<stage.name<<" failed on "<<job.path<<": "<<ex.what();
+			ret = false;
+		}
+		job.processingTime += std::chrono::steady_clock::now() - start;
+		if(!ret)
+		{
+			stage.failures.add();
+			job.failedStage = stage.name;
+		}
+
+		if(ret && stageIndex+1 < stages.size())
+		{
+			stages[stageIndex+1]->queue.push(std::move(job));
+		}
+		else
+		{
+			if(sink)
+				sink(job, ret);
+		}
+		job = Job();
+	}
+}
+
+void Pipeline::start()
+{
+	if(running)
+		return;
+	running = true;
+	for(size_t i = 0; i < stages.size(); ++i)
+	{
+		Log(Log::DEBUG)<<"Starting stage "<<stages[i]->name<<" with "<<stages[i]->workerCount<<" workers";
+		for(size_t j = 0; j < stages[i]->workerCount; ++j)
+			stages[i]->workers.push_back(std::thread(&Pipeline::work, this, i, j));
+	}
+}
+
+bool Pipeline::push(Job job)
+{
+	if(!running || stages.empty())
+		return false;
+	return stages[0]->queue.push(std::move(job));
+}
+
+void Pipeline::finish()
+{
+	if(!running)
+		return;
+
+	//stages are closed in order so that every job pushed downstream is still accepted
+	for(std::unique_ptr<Stage>& stage : stages)
+	{
+		stage->queue.close();
+		for(std::thread& worker : stage->workers)
+			worker.join();
+		stage->workers.clear();
+	}
+	running = false;
+}
+
+size_t Pipeline::stageCount() const
+{
+	return stages.size();
+}
+
+size_t Pipeline::queueDepth(size_t stage) const
+{
+	return stages[stage]->queue.size();
+}
+
+const std::string& Pipeline::stageName(size_t stage) const
+{
+	return stages[stage]->name;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <filesystem>
+
+#include "blockingqueue.h"
+#include "document.h"
+#include "memorybudget.h"
+#include "metrics.h"
+
+struct Job
+{
+	std::filesystem::path path;
+	std::shared_ptr<Document> document;
+	size_t index = 0;
+	//the document was restored from the result cache and is not processed again
+	bool cached = false;
+	MemoryBudget::Reservation reservation;
+	size_t pages = 0;
+	//time spent executing stages, without the time spent waiting in queues
+	std::chrono::steady_clock::duration processingTime = std::chrono::steady_clock::duration::zero();
+	//name of the stage that dropped the job
+	std::string failedStage;
+	//called by the sink of the submitter once the job leaves the pipeline
+	std::function<void(Job& job, bool completed)> done;
+};
+
+class Pipeline
+{
+public:
+	//returns false if the job should be dropped
+	typedef std::function<bool(Job& job)> StageFunction;
+	//called once for every job that leaves the pipeline, either after the last stage or when dropped
+	typedef std::function<void(Job& job, bool completed)> Sink;
+	//called on every worker thread of a stage before it takes any jobs
+	typedef std::function<void(size_t worker)> ThreadInit;
+
+private:
+	struct Stage
+	{
+		std::string name;
+		StageFunction function;
+		ThreadInit init;
+		size_t workerCount;
+		BlockingQueue<Job> queue;
+		std::vector<std::thread> workers;
+		Metrics::Histogram& latency;
+		Metrics::Counter& failures;
+
+		Stage(const std::string& nameI, StageFunction functionI, ThreadInit initI, size_t workerCountI, size_t queueSize):
+		name(nameI), function(functionI), init(initI), workerCount(workerCountI), queue(queueSize),
+		latency(Metrics::global().histogram("stage_" + nameI)),
+		failures(Metrics::global().counter("stage_" + nameI + "_failures")) {}
+	};
+
+	std::vector<std::unique_ptr<Stage>> stages;
+	Sink sink;
+	bool running = false;
+
+private:
+	void work(size_t stageIndex, size_t worker);
+
+public:
+	explicit Pipeline(Sink sinkI = nullptr);
+	~Pipeline();
+	Pipeline(const Pipeline&) = delete;
+	Pipeline& operator=(const Pipeline&) = delete;
+
+	void addStage(const std::string& name, StageFunction function, size_t workers, size_t queueSize, ThreadInit init = nullptr);
+	void start();
+	//blocks while the first stage is saturated
+	bool push(Job job);
+	//drains all stages and joins all workers
+	void finish();
+	size_t stageCount() const;
+	size_t queueDepth(size_t stage) const;
+	const std::string& stageName(size_t stage) const;
+};
@@ -0,0 +1,201 @@
+#include "placement.h"
+
+#include <sched.h>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+
+#include "log.h"
+#include "tokenize.h"
+
+static thread_local int threadNode = -1;
+
+bool parseCpuList(const std::string& list, std::vector<int>& cpus)
+{
+	std::vector<std::string> ranges = tokenize(list, ",");
+	try
+	{
+		for(std::string range : ranges)
+		{
+			range.erase(std::remove_if(range.begin(), range.end(), [](char ch){return std::isspace(static_cast<unsigned char>(ch));}), range.end());
+			if(range.empty())
+				continue;
+			size_t dash = range.find('-');
+			int first = std::stoi(range.substr(0, dash));
+			int last = dash == std::string::npos ? first : std::stoi(range.substr(dash+1));
+			for(int cpu = first; cpu <= last; ++cpu)
+				cpus.push_back(cpu);
+		}
+	}
+	catch(const std::logic_error& ex)
+	{
+		return false;
+	}
+	return true;
+}
+
+std::vector<int> allowedCpus()
+{
+	std::vector<int> cpus;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if(sched_getaffinity(0, sizeof(set), &set) != 0)
+		return cpus;
+	for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+	{
+		if(CPU_ISSET(cpu, &set))
+			cpus.push_back(cpu);
+	}
+	return cpus;
+}
+
+std::vector<NumaNode> numaNodes()
+{
+	std::vector<int> allowed = allowedCpus();
+	std::vector<NumaNode> nodes;
+
+	std::error_code ec;
+	for(const std::filesystem::directory_entry& dirent : std::filesystem::directory_iterator("/sys/devices/system/node", ec))
+	{
+		std::string name = dirent.path().filename();
+		if(name.rfind("node", 0) != 0 || name.size() < 5 || !std::isdigit(static_cast<unsigned char>(name[4])))
+			continue;
+
+		std::ifstream file(dirent.path()/"cpulist");
+		std::string list;
+		std::getline(file, list);
+		std::vector<int> cpus;
+		if(!file.is_open() || !parseCpuList(list, cpus))
+			continue;
+
+		NumaNode node;
+		node.id = std::stoi(name.substr(4));
+		for(int cpu : cpus)
+		{
+			if(std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+				node.cpus.push_back(cpu);
+		}
+		if(!node.cpus.empty())
+			nodes.push_back(node);
+	}
+
+	if(nodes.empty())
+		nodes.push_back({0, allowed});
+
+	std::sort(nodes.begin(), nodes.end(), [](const NumaNode& a, const NumaNode& b){return a.id < b.id;});
+	return nodes;
+}
+
+bool Placement::pin(const std::vector<int>& cpus)
+{
+	if(cpus.empty())
+		return false;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for(int cpu : cpus)
+		CPU_SET(cpu, &set);
+	if(sched_setaffinity(0, sizeof(set), &set) != 0)
+	{
+		Log(Log::WARN)<<"Could not set cpu affinity";
+		return false;
+	}
+	return true;
+}
+
+void Placement::plan(size_t inferenceWorkers)
+{
+	nodes = numaNodes();
+	inferenceCpus.clear();
+	inferenceNodes.clear();
+	otherCpus.clear();
+
+	size_t cpuCount = 0;
+	for(const NumaNode& node : nodes)
+		cpuCount += node.cpus.size();
+	if(cpuCount == 0)
+	{
+		Log(Log::WARN)<<"Could not determine usable cpus, not pinning threads";
+		return;
+	}
+
+	//inference workers are dealt round robin over the nodes, each taking the next free cpu of its node
+	//at least one cpu is left for the other stages when possible
+	size_t inferenceCount = std::min(inferenceWorkers, cpuCount > 1 ? cpuCount-1 : cpuCount);
+	std::vector<size_t> used(nodes.size(), 0);
+	for(size_t node = 0; inferenceCpus.size() < inferenceCount; node = (node+1) % nodes.size())
+	{
+		if(used[node] >= nodes[node].cpus.size())
+			continue;
+		inferenceCpus.push_back(nodes[node].cpus[used[node]++]);
+		inferenceNodes.push_back(nodes[node].id);
+	}
+
+	for(size_t i = 0; i < nodes.size(); ++i)
+		otherCpus.insert(otherCpus.end(), nodes[i].cpus.begin()+used[i], nodes[i].cpus.end());
+	if(otherCpus.empty())
+		otherCpus = inferenceCpus;
+
+	enabled = true;
+}
+
+void Placement::pinInference(size_t worker) const
+{
+	if(!enabled)
+		return;
+	//more workers than cpus share them round robin
+	size_t slot = worker % inferenceCpus.size();
+	if(pin({inferenceCpus[slot]}))
+		threadNode = inferenceNodes[slot];
+}
+
+void Placement::pinOther() const
+{
+	if(!enabled)
+		return;
+	pin(otherCpus);
+}
+
+int Placement::pinReplica(size_t replica) const
+{
+	if(!enabled)
+		return -1;
+	//replicas follow the inference workers so that every node holds the weights its workers use
+	int node = inferenceNodes[replica % inferenceNodes.size()];
+	for(const NumaNode& numaNode : nodes)
+	{
+		if(numaNode.id == node && pin(numaNode.cpus))
+		{
+			threadNode = node;
+			return node;
+		}
+	}
+	return -1;
+}
+
+void Placement::report() const
+{
+	if(!enabled)
+		return;
+
+	for(const NumaNode& node : nodes)
+	{
+		std::stringstream ss;
+		for(size_t i = 0; i < node.cpus.size(); ++i)
+			ss<<(i > 0 ? "," : "")<<node.cpus[i];
+		Log(Log::INFO)<<"Numa node "<<node.id<<": cpus "<<ss.str();
+	}
+	for(size_t i = 0; i < inferenceCpus.size(); ++i)
+		Log(Log::INFO)<<"Inference worker "<<i<<" pinned to cpu "<<inferenceCpus[i]<<" on node "<<inferenceNodes[i];
+	std::stringstream ss;
+	for(size_t i = 0; i < otherCpus.size(); ++i)
+		ss<<(i > 0 ? "," : "")<<otherCpus[i];
+	Log(Log::INFO)<<"Load, parse and io workers pinned to cpus "<<ss.str();
+}
+
+int Placement::currentNode()
+{
+	return threadNode;
+}
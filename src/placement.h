@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstddef>
+
+struct NumaNode
+{
+	int id;
+	std::vector<int> cpus;
+};
+
+//parses lists like 0-3,8,10-11 as used in sysfs
+bool parseCpuList(const std::string& list, std::vector<int>& cpus);
+
+//cpus in the affinity mask of this process
+std::vector<int> allowedCpus();
+
+//numa nodes with the cpus of each node this process may run on, a single node with all allowed cpus if the topology is unkown
+std::vector<NumaNode> numaNodes();
+
+//decides which cpus inference workers and all other workers run on
+//inference workers are spread over the numa nodes and get a cpu of their own, everything else shares the remaining cpus
+class Placement
+{
+private:
+	std::vector<NumaNode> nodes;
+	std::vector<int> inferenceCpus;
+	std::vector<int> inferenceNodes;
+	std::vector<int> otherCpus;
+	bool enabled = false;
+
+private:
+	static bool pin(const std::vector<int>& cpus);
+
+public:
+	//workers past the planned cpus wrap around and share, callers with several pools offset their worker indices
+	void plan(size_t inferenceWorkers);
+	bool isEnabled() const {return enabled;}
+	//pins the calling thread to the cpu of inference worker
+	void pinInference(size_t worker) const;
+	//pins the calling thread to the cpus not used for inference
+	void pinOther() const;
+	//pins the calling thread to the cpus of the node that replica should live on and returns that node
+	int pinReplica(size_t replica) const;
+	void report() const;
+
+	//numa node the calling thread was pinned to, -1 if it was not pinned
+	static int currentNode();
+};
@@ -3,6 +3,7 @@
 #include <poppler-document.h>
 #include <poppler-page.h>
 #include <poppler-page-renderer.h>
+#include <algorithm>
 
 #include "log.h"
 
@@ -33,33 +34,60 @@ int popplerEnumToCvFormat(int format)
 	return cvFormat;
 }
 
-std::vector<cv::Mat> getMatsFromDocument(poppler::document* document, const cv::Size& size)
+double dpiForLongSide(const poppler::page* page, int longSide)
+{
+	//page_rect is in points, 72 per inch
+	poppler::rectf rect = page->page_rect();
+	double longSidePoints = std::max(rect.width(), rect.height());
+	if(longSidePoints <= 0)
+		longSidePoints = 842; //A4
+	return longSide*72.0/longSidePoints;
+}
+
+cv::Mat wrapImage(const poppler::image& image)
+{
+	int format = popplerEnumToCvFormat(image.format());
+	if(format < 0)
+		return cv::Mat();
+	return cv::Mat(image.height(), image.width(), format, const_cast<char*>(image.const_data()), image.bytes_per_row());
+}
+
+void setupRenderer(poppler::page_renderer& renderer, bool gray)
 {
-	poppler::page_renderer renderer;
 	renderer.set_render_hint(poppler::page_renderer::antialiasing, true);
+	//rendered straight into the channel order opencv uses so that the image can be used without conversion
+	renderer.set_image_format(gray ? poppler::image::format_gray8 : poppler::image::format_bgr24);
+}
 
-	int pagesCount = document->pages();
+RenderedPage renderPage(poppler::page_renderer& renderer, poppler::page* page, int longSide, bool gray, const cv::Rect& region)
+{
+	RenderedPage rendered;
+	//rendered directly at the resolution the detectors need, the aspect ratio of the page is kept
+	double dpi = dpiForLongSide(page, longSide);
+	poppler::image image = region.empty() ? renderer.render_page(page, dpi, dpi) :
+		renderer.render_page(page, dpi, dpi, region.x, region.y, region.width, region.height);
 
-	if(pagesCount > 10)
+	cv::Mat wrapped = wrapImage(image);
+	if(wrapped.empty())
 	{
-		Log(Log::WARN)<<"only loading first 10 pages of "<<pagesCount;
-		pagesCount = 10;
+		Log(Log::WARN)<<"Unsupported image format "<<image.format()<<" from renderer";
+		return rendered;
 	}
-	std::vector<cv::Mat> output;
 
-	for(int i = 0; i < pagesCount; ++i)
+	//a renderer that ignored the requested format, argb32 is BGRA in memory
+	if(image.format() == poppler::image::format_argb32)
+	{
+		cv::cvtColor(wrapped, rendered.image, gray ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGRA2BGR);
+	}
+	else if(image.format() == poppler::image::format_rgb24)
+	{
+		cv::cvtColor(wrapped, rendered.image, gray ? cv::COLOR_RGB2GRAY : cv::COLOR_RGB2BGR);
+	}
+	else
 	{
-		poppler::page* page = document->create_page(i);
-		poppler::rectf pagesize = page->page_rect();
-		poppler::image image = renderer.render_page(page, size.width/4, size.height/4);
-		cv::Mat cvBufferConst(image.height(), image.width(), popplerEnumToCvFormat(image.format()),
-		                 const_cast<char*>(image.const_data()), image.bytes_per_row());
-		cv::Mat cvBuffer(cvBufferConst.clone());
-		if(image.format() == poppler::image::format_rgb24 || image.format() == poppler::image::format_argb32)
-			cvtColor(cvBuffer, cvBuffer, cv::COLOR_RGB2BGR);
-		cv::resize(cvBuffer, cvBuffer, size, 0, 0, cv::INTER_LINEAR);
-		output.push_back(cvBuffer);
-		delete page;
+		//the mat points into the image which is kept alongside it
+		rendered.buffer = image;
+		rendered.image = wrapped;
 	}
-	return output;
+	return rendered;
 }
@@ -1,9 +1,36 @@
 #pragma once
 
 #include <poppler-document.h>
+#include <poppler-page.h>
+#include <poppler-image.h>
+#include <poppler-page-renderer.h>
 #include <opencv2/core.hpp>
 #include <vector>
+#include <string>
 
 int popplerEnumToCvFormat(int format);
 
-std::vector<cv::Mat> getMatsFromDocument(poppler::document* document, const cv::Size& size);
+//resolution at which the longer side of page is rendered with longSide pixels
+double dpiForLongSide(const poppler::page* page, int longSide);
+
+//wraps the image data without copying it, the returned mat is only valid while image exists
+cv::Mat wrapImage(const poppler::image& image);
+
+struct RenderedPage
+{
+	//may point into buffer, copies of image must not outlive the RenderedPage
+	cv::Mat image;
+	poppler::image buffer;
+	//index of the page in the pdf
+	size_t number = 0;
+	//only extracted if the source was asked for text
+	std::string text;
+	//pixels of a full resolution render per pixel of image
+	double scale = 1;
+};
+
+void setupRenderer(poppler::page_renderer& renderer, bool gray);
+
+//renders page with its longer side at longSide pixels without copying the rendered image
+//if region is not empty only that part of the page, in pixels of the render, is rendered
+RenderedPage renderPage(poppler::page_renderer& renderer, poppler::page* page, int longSide, bool gray, const cv::Rect& region = cv::Rect());
@@ -0,0 +1,169 @@
+#include "progress.h"
+
+#include <cmath>
+#include <sstream>
+#include <iostream>
+#include <cerrno>
+#include <unistd.h>
+
+#include "json.h"
+#include "log.h"
+
+Progress::Progress(std::chrono::seconds intervalI, int jsonFdI):
+interval(intervalI), jsonFd(jsonFdI)
+{
+	startTime = std::chrono::steady_clock::now();
+	lastReport = startTime;
+	lastCompletion = startTime;
+}
+
+Progress::~Progress()
+{
+	finish();
+}
+
+void Progress::start()
+{
+	if(thread.joinable())
+		return;
+	stop = false;
+	thread = std::thread(&Progress::loop, this);
+}
+
+void Progress::finish()
+{
+	{
+		std::scoped_lock lock(mutex);
+		if(!thread.joinable())
+			return;
+		stop = true;
+	}
+	wake.notify_all();
+	thread.join();
+}
+
+void Progress::loop()
+{
+	std::unique_lock lock(mutex);
+	while(!stop)
+	{
+		wake.wait_for(lock, interval, [this](){return stop;});
+		report();
+	}
+}
+
+void Progress::documentDone(size_t pages, size_t circuts, size_t skippedPages)
+{
+	std::scoped_lock lock(mutex);
+	++totals.documents;
+	totals.pages += pages;
+	totals.circuts += circuts;
+	totals.skippedPages += skippedPages;
+	lastCompletion = std::chrono::steady_clock::now();
+}
+
+void Progress::documentFailed(const std::string& reason)
+{
+	std::scoped_lock lock(mutex);
+	++failed;
+	++failureReasons[reason];
+	lastCompletion = std::chrono::steady_clock::now();
+}
+
+void Progress::documentSkipped()
+{
+	std::scoped_lock lock(mutex);
+	++skipped;
+}
+
+void Progress::setTotal(size_t totalI, bool final)
+{
+	std::scoped_lock lock(mutex);
+	total = totalI;
+	totalFinal = final;
+}
+
+std::string Progress::formatDuration(double seconds)
+{
+	size_t rounded = std::llround(seconds);
+	std::stringstream ss;
+	if(rounded >= 3600)
+		ss<<rounded/3600<<'h';
+	if(rounded >= 60)
+		ss<<(rounded/60)%60<<'m';
+	ss<<rounded%60<<'s';
+	return ss.str();
+}
+
+//expects mutex to be held
+void Progress::report()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double elapsed = std::chrono::duration<double>(now - lastReport).count();
+	double runtime = std::chrono::duration<double>(now - startTime).count();
+	double idle = std::chrono::duration<double>(now - lastCompletion).count();
+	if(elapsed <= 0)
+		return;
+
+	double pageRate = (totals.pages - lastTotals.pages)/elapsed;
+	double circutRate = (totals.circuts - lastTotals.circuts)/elapsed;
+	size_t finished = totals.documents + failed;
+	double instantRate = (finished - lastFinished)/elapsed;
+	documentRate = rateValid ? RATE_ALPHA*instantRate + (1-RATE_ALPHA)*documentRate : instantRate;
+	rateValid = true;
+	lastTotals = totals;
+	lastFinished = finished;
+	lastReport = now;
+
+	size_t processed = finished + skipped;
+	bool etaValid = totalFinal && documentRate > 0;
+	double eta = etaValid ? (total > processed ? total - processed : 0)/documentRate : 0;
+
+	std::stringstream ss;
+	if(jsonFd >= 0)
+	{
+		ss<<"{\"progress\":{\"done\":"<<totals.documents<<",\"failed\":"<<failed<<",\"skipped\":"<<skipped
+			<<",\"total\":"<<total<<",\"total_final\":"<<(totalFinal ? "true" : "false")
+			<<",\"pages_per_second\":"<<pageRate<<",\"circuts_per_second\":"<<circutRate<<",\"pages_skipped\":"<<totals.skippedPages
+			<<",\"documents_per_second\":"<<documentRate<<",\"eta_seconds\":";
+		if(etaValid)
+			ss<<eta;
+		else
+			ss<<"null";
+		ss<<",\"runtime_seconds\":"<<runtime<<",\"idle_seconds\":"<<idle<<",\"failures\":{";
+		bool first = true;
+		for(const std::pair<const std::string, size_t>& reason : failureReasons)
+		{
+			ss<<(first ? "" : ",")<<jsonString(reason.first)<<':'<<reason.second;
+			first = false;
+		}
+		ss<<"}}}\n";
+		//every line is written at once so that readers never see a partial line
+		std::string line = ss.str();
+		size_t written = 0;
+		while(written < line.size())
+		{
+			ssize_t ret = write(jsonFd, line.data()+written, line.size()-written);
+			if(ret < 0 && errno == EINTR)
+				continue;
+			if(ret <= 0)
+				break;
+			written += ret;
+		}
+	}
+	else
+	{
+		ss<<"Progress: "<<processed<<'/'<<total<<(totalFinal ? "" : "+")<<" documents, "
+			<<documentRate<<" documents/s, "<<pageRate<<" pages/s, "<<circutRate<<" circuts/s, ETA "
+			<<(etaValid ? formatDuration(eta) : std::string("unkown"));
+		if(totals.skippedPages > 0)
+			ss<<", "<<totals.skippedPages<<'/'<<totals.pages<<" pages skipped by triage";
+		if(failed > 0)
+		{
+			ss<<", failed:";
+			for(const std::pair<const std::string, size_t>& reason : failureReasons)
+				ss<<' '<<reason.first<<' '<<reason.second;
+		}
+		Log(Log::INFO)<<ss.str();
+	}
+}
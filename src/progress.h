@@ -0,0 +1,70 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <cstddef>
+#include <condition_variable>
+
+//periodically reports throughput, failures and an estimated time to completion
+//as a log line on a terminal and as a json line otherwise so that schedulers can detect stalled runs
+class Progress
+{
+private:
+	struct Totals
+	{
+		size_t documents = 0;
+		size_t pages = 0;
+		size_t circuts = 0;
+		size_t skippedPages = 0;
+	};
+
+	std::chrono::seconds interval;
+	//json lines are written here, log lines are used if it is negative
+	int jsonFd;
+
+	mutable std::mutex mutex;
+	Totals totals;
+	Totals lastTotals;
+	size_t lastFinished = 0;
+	size_t failed = 0;
+	size_t skipped = 0;
+	std::map<std::string, size_t> failureReasons;
+	size_t total = 0;
+	bool totalFinal = false;
+	double documentRate = 0;
+	bool rateValid = false;
+	std::chrono::steady_clock::time_point startTime;
+	std::chrono::steady_clock::time_point lastReport;
+	std::chrono::steady_clock::time_point lastCompletion;
+
+	std::thread thread;
+	std::condition_variable wake;
+	bool stop = false;
+
+private:
+	void report();
+	void loop();
+	static std::string formatDuration(double seconds);
+
+public:
+	//smoothing factor of the moving average of the document rate
+	static constexpr double RATE_ALPHA = 0.3;
+
+	//jsonFdI receives the json lines and must not be shared with the log, it is not closed by Progress
+	Progress(std::chrono::seconds intervalI, int jsonFdI = -1);
+	~Progress();
+	Progress(const Progress&) = delete;
+	Progress& operator=(const Progress&) = delete;
+
+	void start();
+	//writes a final report
+	void finish();
+	//skippedPages are the pages triage kept from the detectors
+	void documentDone(size_t pages, size_t circuts, size_t skippedPages = 0);
+	void documentFailed(const std::string& reason);
+	void documentSkipped();
+	//final is set once every input has been enumerated, before that no eta is given
+	void setTotal(size_t totalI, bool final);
+};
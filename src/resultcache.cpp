@@ -0,0 +1,113 @@
+#include "resultcache.h"
+
+#include <fstream>
+#include <system_error>
+#include <unistd.h>
+#include <limits.h>
+
+#include "hash.h"
+#include "log.h"
+
+ResultCache::ResultCache(const std::filesystem::path& baseDir, uint64_t modelHash):
+dir(baseDir/hashToString(modelHash))
+{
+	char hostname[HOST_NAME_MAX+1] = {};
+	gethostname(hostname, HOST_NAME_MAX);
+	tempSuffix = std::string(".tmp.") + hostname + "." + std::to_string(getpid()) + ".";
+}
+
+bool ResultCache::open()
+{
+	std::error_code ec;
+	std::filesystem::create_directories(dir, ec);
+	if(ec || !std::filesystem::is_directory(dir))
+	{
+		Log(Log::ERROR)<<dir<<" is not a directory and a directory could not be created at this location";
+		return false;
+	}
+	return true;
+}
+
+std::filesystem::path ResultCache::entryPath(uint64_t contentHash) const
+{
+	std::string hashStr = hashToString(contentHash);
+	return dir/hashStr.substr(0, 2)/(hashStr + ".txt");
+}
+
+std::shared_ptr<Document> ResultCache::find(uint64_t contentHash, const std::string& fileName)
+{
+	std::fstream file(entryPath(contentHash), std::ios_base::in);
+	if(!file.is_open())
+	{
+		++misses;
+		return std::shared_ptr<Document>();
+	}
+
+	std::shared_ptr<Document> document = Document::readResults(file, fileName, contentHash);
+	if(!document)
+	{
+		Log(Log::WARN)<<"Ignoreing invalid cache entry "<<entryPath(contentHash);
+		++misses;
+		return document;
+	}
+
+	Log(Log::DEBUG)<<"Cache hit for "<<fileName;
+	++hits;
+	return document;
+}
+
+bool ResultCache::store(Document& document)
+{
+	std::filesystem::path path = entryPath(document.getContentHash());
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	//entries are written under a name unique to this process and renamed into place so readers never see partial entries
+	std::filesystem::path tempPath = path;
+	tempPath += tempSuffix + std::to_string(tempCounter++);
+
+	std::fstream file(tempPath, std::ios_base::out | std::ios_base::trunc);
+	if(!file.is_open())
+	{
+		Log(Log::WARN)<<"Could not open "<<tempPath<<" for writeing";
+		return false;
+	}
+	document.writeResults(file);
+	file.close();
+	if(file.fail())
+	{
+		Log(Log::WARN)<<"Could not write cache entry "<<tempPath;
+		std::filesystem::remove(tempPath, ec);
+		return false;
+	}
+
+	std::filesystem::rename(tempPath, path, ec);
+	if(ec)
+	{
+		Log(Log::WARN)<<"Could not move cache entry to "<<path<<": "<<ec.message();
+		std::filesystem::remove(tempPath, ec);
+		return false;
+	}
+	++stored;
+	return true;
+}
+
+size_t ResultCache::getHits() const
+{
+	return hits;
+}
+
+size_t ResultCache::getMisses() const
+{
+	return misses;
+}
+
+size_t ResultCache::getStored() const
+{
+	return stored;
+}
+
+const std::filesystem::path& ResultCache::getDirectory() const
+{
+	return dir;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <filesystem>
+
+#include "document.h"
+
+//content addressed store of document results, safe to share between processes and machines
+class ResultCache
+{
+private:
+	std::filesystem::path dir;
+	std::atomic<size_t> hits = 0;
+	std::atomic<size_t> misses = 0;
+	std::atomic<size_t> stored = 0;
+	std::atomic<size_t> tempCounter = 0;
+	std::string tempSuffix;
+
+private:
+	std::filesystem::path entryPath(uint64_t contentHash) const;
+
+public:
+	//entries are kept below a directory named after the model hash so that changeing networks invalidates them
+	ResultCache(const std::filesystem::path& baseDir, uint64_t modelHash);
+	bool open();
+	std::shared_ptr<Document> find(uint64_t contentHash, const std::string& fileName);
+	bool store(Document& document);
+	size_t getHits() const;
+	size_t getMisses() const;
+	size_t getStored() const;
+	const std::filesystem::path& getDirectory() const;
+};
@@ -0,0 +1,235 @@
+#include "scheduling.h"
+
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#include <poppler-document.h>
+
+#include "log.h"
+#include "tokenize.h"
+
+//relative cost of a MiB of file compared to a rendered page when no history is available
+static constexpr double MIB_PER_PAGE = 1.0;
+//seconds per cost unit assumed when no history is available
+static constexpr double DEFAULT_SECONDS_PER_UNIT = 1.0;
+
+std::string CostHistory::key(const std::filesystem::path& path)
+{
+	std::error_code ec;
+	std::filesystem::path absolute = std::filesystem::absolute(path, ec);
+	return ec ? path.string() : absolute.lexically_normal().string();
+}
+
+bool CostHistory::open(const std::filesystem::path& path)
+{
+	std::scoped_lock lock(mutex);
+
+	std::fstream in(path, std::ios_base::in);
+	size_t lines = 0;
+	while(in.good())
+	{
+		std::string line;
+		std::getline(in, line);
+		if(line.empty() || in.eof())
+			continue;
+		++lines;
+		std::vector<std::string> tokens = tokenize(line, "\t");
+		if(tokens.size() < 3)
+			continue;
+		try
+		{
+			Entry entry;
+			entry.size = std::stoull(tokens[0]);
+			entry.seconds = std::stod(tokens[1]);
+			entries[line.substr(tokens[0].size() + tokens[1].size() + 2)] = entry;
+		}
+		catch(const std::logic_error& ex)
+		{
+			continue;
+		}
+	}
+	in.close();
+
+	//every run appends the documents it processed, only the last entry of a path is kept when the history is compacted
+	if(lines > entries.size())
+		compact(path);
+
+	file.open(path, std::ios_base::out | std::ios_base::app);
+	if(!file.is_open())
+	{
+		Log(Log::WARN)<<"Could not open cost history "<<path<<" for writeing";
+		return false;
+	}
+	return true;
+}
+
+void CostHistory::compact(const std::filesystem::path& path) const
+{
+	//written to a temporary and renamed so that a crash keeps the old history
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp";
+	std::fstream out(tempPath, std::ios_base::out | std::ios_base::trunc);
+	if(!out.is_open())
+	{
+		Log(Log::WARN)<<"Could not open "<<tempPath<<" for writeing";
+		return;
+	}
+	for(const std::pair<const std::string, Entry>& entry : entries)
+		out<<entry.second.size<<'\t'<<entry.second.seconds<<'\t'<<entry.first<<'\n';
+	out.close();
+
+	std::error_code ec;
+	if(!out.fail())
+		std::filesystem::rename(tempPath, path, ec);
+	if(out.fail() || ec)
+	{
+		Log(Log::WARN)<<"Could not compact cost history "<<path;
+		std::filesystem::remove(tempPath, ec);
+	}
+}
+
+bool CostHistory::find(const std::filesystem::path& path, uintmax_t size, double& seconds) const
+{
+	std::scoped_lock lock(mutex);
+	auto iterator = entries.find(key(path));
+	if(iterator == entries.end() || iterator->second.size != size)
+		return false;
+	seconds = iterator->second.seconds;
+	return true;
+}
+
+void CostHistory::record(const std::filesystem::path& path, double seconds)
+{
+	std::error_code ec;
+	Entry entry;
+	entry.size = std::filesystem::file_size(path, ec);
+	entry.seconds = seconds;
+	if(ec)
+		return;
+
+	std::string filePath = key(path);
+	std::scoped_lock lock(mutex);
+	entries[filePath] = entry;
+	if(file.is_open())
+		file<<entry.size<<'\t'<<seconds<<'\t'<<filePath<<'\n'<<std::flush;
+}
+
+size_t CostHistory::size() const
+{
+	std::scoped_lock lock(mutex);
+	return entries.size();
+}
+
+static size_t pageCount(const std::filesystem::path& path)
+{
+	//only the cross reference table and page tree are parsed, nothing is rendered
+	poppler::document* document = poppler::document::load_from_file(path.string());
+	if(!document)
+		return 0;
+	size_t pages = document->pages();
+	delete document;
+	return pages;
+}
+
+std::vector<CostedFile> estimateCosts(const std::vector<std::filesystem::path>& files, const CostHistory* history,
+									  const PageSelection& selection, size_t threads)
+{
+	std::vector<CostedFile> costed(files.size());
+	std::atomic<size_t> next = 0;
+
+	auto scan = [&]()
+	{
+		for(size_t i = next++; i < files.size(); i = next++)
+		{
+			CostedFile& file = costed[i];
+			file.path = files[i];
+			std::error_code ec;
+			file.size = std::filesystem::file_size(file.path, ec);
+			if(ec)
+				file.size = 0;
+			file.pages = pageCount(file.path);
+			if(history && history->find(file.path, file.size, file.cost))
+				file.measured = true;
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for(size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+		workers.push_back(std::thread(scan));
+	for(std::thread& worker : workers)
+		worker.join();
+
+	auto units = [&selection](const CostedFile& file)
+	{
+		size_t pages = selection.count(file.pages);
+		return pages + MIB_PER_PAGE*file.size/(1024.0*1024.0);
+	};
+
+	//documents measured in previous runs calibrate how long a unit takes
+	double measuredSeconds = 0;
+	double measuredUnits = 0;
+	size_t measuredCount = 0;
+	for(const CostedFile& file : costed)
+	{
+		if(!file.measured)
+			continue;
+		measuredSeconds += file.cost;
+		measuredUnits += units(file);
+		++measuredCount;
+	}
+	double secondsPerUnit = DEFAULT_SECONDS_PER_UNIT;
+	if(measuredCount > 0 && measuredUnits > 0)
+		secondsPerUnit = measuredSeconds/measuredUnits;
+
+	for(CostedFile& file : costed)
+	{
+		if(!file.measured)
+			file.cost = units(file)*secondsPerUnit;
+	}
+
+	Log(Log::INFO)<<"Estimated the cost of "<<costed.size()<<" files, "<<measuredCount<<" from previous runs";
+	return costed;
+}
+
+static void sortByCost(std::vector<CostedFile>& files)
+{
+	//every node has to arrive at the same order regardless of the order files where enumerated in
+	std::sort(files.begin(), files.end(), [](const CostedFile& a, const CostedFile& b)
+	{
+		if(a.cost != b.cost)
+			return a.cost > b.cost;
+		return a.path < b.path;
+	});
+}
+
+std::vector<std::filesystem::path> orderByCost(std::vector<CostedFile> files)
+{
+	sortByCost(files);
+	std::vector<std::filesystem::path> ordered;
+	ordered.reserve(files.size());
+	for(const CostedFile& file : files)
+		ordered.push_back(file.path);
+	return ordered;
+}
+
+std::vector<std::filesystem::path> selectShard(std::vector<CostedFile> files, size_t index, size_t count)
+{
+	sortByCost(files);
+
+	//greedy longest processing time first assignment to the shard with the least cost so far
+	std::vector<double> shardCosts(count, 0);
+	std::vector<std::filesystem::path> selected;
+	for(const CostedFile& file : files)
+	{
+		size_t shard = std::min_element(shardCosts.begin(), shardCosts.end()) - shardCosts.begin();
+		shardCosts[shard] += file.cost;
+		if(shard == index)
+			selected.push_back(file.path);
+	}
+
+	Log(Log::INFO)<<"Shard "<<index<<" of "<<count<<" has "<<selected.size()<<" of "<<files.size()
+		<<" files with an estimated cost of "<<shardCosts[index]<<" s";
+	return selected;
+}
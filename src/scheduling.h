@@ -0,0 +1,59 @@
+#pragma once
+#include <mutex>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+
+#include "pagesource.h"
+
+//processing times of documents in previous runs, keyed by path and file size
+class CostHistory
+{
+private:
+	struct Entry
+	{
+		uintmax_t size;
+		double seconds;
+	};
+
+	std::unordered_map<std::string, Entry> entries;
+	std::fstream file;
+	mutable std::mutex mutex;
+
+private:
+	static std::string key(const std::filesystem::path& path);
+	//rewrites the history with one line per path
+	void compact(const std::filesystem::path& path) const;
+
+public:
+	bool open(const std::filesystem::path& path);
+	bool find(const std::filesystem::path& path, uintmax_t size, double& seconds) const;
+	void record(const std::filesystem::path& path, double seconds);
+	size_t size() const;
+};
+
+struct CostedFile
+{
+	std::filesystem::path path;
+	uintmax_t size = 0;
+	size_t pages = 0;
+	//estimated processing time in seconds
+	double cost = 0;
+	bool measured = false;
+};
+
+//estimates the cost of every file from its size and page count without rendering it
+//files with a history entry use their measured time and calibrate the estimate of the others
+//only the pages in selection are counted
+std::vector<CostedFile> estimateCosts(const std::vector<std::filesystem::path>& files, const CostHistory* history,
+									  const PageSelection& selection, size_t threads);
+
+//orders files so that the most expensive ones are dispatched first
+std::vector<std::filesystem::path> orderByCost(std::vector<CostedFile> files);
+
+//deterministically partitions files into count shards of similar total cost and returns the files of shard index, most expensive first
+std::vector<std::filesystem::path> selectShard(std::vector<CostedFile> files, size_t index, size_t count);
@@ -0,0 +1,222 @@
+#include "statistics.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+#include "log.h"
+#include "tokenize.h"
+
+static constexpr int PARTIAL_FORMAT_VERSION = 1;
+
+bool Statistics::replaceFile(const std::filesystem::path& path, const std::string& content)
+{
+	//snapshots are rewritten during the run, write a temporary and rename it so readers never see a partial file
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp";
+
+	std::fstream file;
+	file.open(tempPath, std::ios_base::out | std::ios_base::trunc);
+	if(!file.is_open())
+	{
+		Log(Log::ERROR)<<"Could not open "<<tempPath<<" for writeing";
+		return false;
+	}
+	file<<content;
+	file.close();
+	if(file.fail())
+	{
+		Log(Log::ERROR)<<"Could not write "<<tempPath;
+		return false;
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tempPath, path, ec);
+	if(ec)
+	{
+		Log(Log::ERROR)<<"Could not move "<<tempPath<<" to "<<path<<": "<<ec.message();
+		std::filesystem::remove(tempPath, ec);
+		return false;
+	}
+	return true;
+}
+
+size_t Statistics::removeLessThanN(CircutMap& map, size_t n)
+{
+	size_t otherCount = 0;
+	for(const std::pair<std::string, size_t> circut : map)
+	{
+		if(circut.second < n)
+			otherCount += circut.second;
+	}
+	std::erase_if(map, [n](const std::pair<std::string, size_t>& circut)->bool{return circut.second < n;});
+
+	return otherCount;
+}
+
+void Statistics::addDocument(Document& document)
+{
+	++documentCount;
+	CircutMap& fieldMap = fields[document.getField()];
+
+	for(Circut& circut : document.circuts)
+	{
+		std::string circutStr = circut.getString();
+
+		if(circutStr.find("s") != std::string::npos || circutStr.find("x") != std::string::npos)
+			continue;
+
+		++fieldMap[circutStr];
+	}
+}
+
+void Statistics::addCircut(const std::string& field, const std::string& circut, size_t count)
+{
+	fields[field][circut] += count;
+}
+
+void Statistics::merge(const Statistics& other)
+{
+	documentCount += other.documentCount;
+	for(const std::pair<const std::string, CircutMap>& field : other.fields)
+	{
+		CircutMap& fieldMap = fields[field.first];
+		for(const std::pair<const std::string, size_t>& circut : field.second)
+			fieldMap[circut.first] += circut.second;
+	}
+}
+
+size_t Statistics::getDocumentCount() const
+{
+	return documentCount;
+}
+
+size_t Statistics::getFieldCount() const
+{
+	return fields.size();
+}
+
+bool Statistics::saveReport(const std::filesystem::path& path, bool quiet) const
+{
+	CircutMap allCircutMap;
+	std::map<std::string, CircutMap, CompString> fieldMaps = fields;
+
+	if(!quiet)
+		Log(Log::INFO)<<"Found "<<fields.size()<<" fields:";
+	for(const std::pair<const std::string, CircutMap>& field : fieldMaps)
+	{
+		if(!quiet)
+			Log(Log::INFO)<<field.first;
+		for(const std::pair<const std::string, size_t>& circut : field.second)
+			allCircutMap[circut.first] += circut.second;
+	}
+
+	size_t allCircutOtherCount = removeLessThanN(allCircutMap, 3);
+
+	if(!quiet)
+		Log(Log::INFO)<<"Saveing statistics to "<<path;
+	std::stringstream file;
+	if(fieldMaps.size() > 1)
+		file<<"All circuts:\n";
+	size_t i = 0;
+	for(const std::pair<std::string, size_t> circut : allCircutMap)
+	{
+		file<<i<<",\t"<<circut.second<<",\t"<<circut.first<<'\n';
+		++i;
+	}
+	file<<i<<",\t"<<allCircutOtherCount<<",\tother\n\n";
+
+	if(fieldMaps.size() > 1)
+	{
+		i = 0;
+		for(std::pair<std::string, CircutMap> field : fieldMaps)
+		{
+			size_t otherCount = removeLessThanN(field.second, 3);
+			file<<field.first<<":\n";
+			for(const std::pair<std::string, size_t> circut : field.second)
+			{
+				file<<i<<",\t"<<circut.second<<",\t"<<circut.first<<'\n';
+				++i;
+			}
+			file<<i<<",\t"<<otherCount<<",\tother\n\n";
+		}
+	}
+	file<<'\n';
+
+	return replaceFile(path, file.str());
+}
+
+bool Statistics::savePartial(const std::filesystem::path& path) const
+{
+	std::stringstream file;
+	file<<"statistics\t"<<PARTIAL_FORMAT_VERSION<<'\n';
+	file<<"documents\t"<<documentCount<<'\n';
+	for(const std::pair<const std::string, CircutMap>& field : fields)
+	{
+		file<<"field\t"<<field.first<<'\n';
+		for(const std::pair<const std::string, size_t>& circut : field.second)
+			file<<"circut\t"<<circut.second<<'\t'<<circut.first<<'\n';
+	}
+	file<<"end\n";
+
+	return replaceFile(path, file.str());
+}
+
+bool Statistics::loadPartial(const std::filesystem::path& path)
+{
+	std::fstream file;
+	file.open(path, std::ios_base::in);
+	if(!file.is_open())
+	{
+		Log(Log::ERROR)<<"Could not open "<<path;
+		return false;
+	}
+
+	Statistics partial;
+	std::string field;
+	bool versionOk = false;
+	while(file.good())
+	{
+		std::string line;
+		std::getline(file, line);
+		std::vector<std::string> tokens = tokenize(line, "\t");
+
+		try
+		{
+			if(tokens[0] == "statistics")
+			{
+				versionOk = tokens.size() == 2 && std::stoi(tokens[1]) == PARTIAL_FORMAT_VERSION;
+			}
+			else if(!versionOk)
+			{
+				break;
+			}
+			else if(tokens[0] == "documents" && tokens.size() == 2)
+			{
+				partial.documentCount = std::stoull(tokens[1]);
+			}
+			else if(tokens[0] == "field" && tokens.size() == 2)
+			{
+				field = tokens[1];
+				partial.fields[field];
+			}
+			else if(tokens[0] == "circut" && tokens.size() == 3)
+			{
+				partial.addCircut(field, tokens[2], std::stoull(tokens[1]));
+			}
+			else if(tokens[0] == "end")
+			{
+				merge(partial);
+				return true;
+			}
+		}
+		catch(const std::logic_error& ex)
+		{
+			break;
+		}
+	}
+
+	Log(Log::ERROR)<<path<<" is not a valid or complete statistics file";
+	return false;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <map>
+#include <string>
+#include <filesystem>
+
+#include "document.h"
+#include "utils.h"
+
+class Statistics
+{
+public:
+	typedef std::map<std::string, size_t, CompString> CircutMap;
+
+private:
+	std::map<std::string, CircutMap, CompString> fields;
+	size_t documentCount = 0;
+
+private:
+	static size_t removeLessThanN(CircutMap& map, size_t n);
+	static bool replaceFile(const std::filesystem::path& path, const std::string& content);
+
+public:
+	//only the circut counts are kept, the document may be freed afterwards
+	void addDocument(Document& document);
+	void addCircut(const std::string& field, const std::string& circut, size_t count = 1);
+	void merge(const Statistics& other);
+	size_t getDocumentCount() const;
+	size_t getFieldCount() const;
+
+	//final human readable report
+	bool saveReport(const std::filesystem::path& path, bool quiet = false) const;
+	//raw counts that can be loaded again and merged with the statistics of other runs
+	bool savePartial(const std::filesystem::path& path) const;
+	bool loadPartial(const std::filesystem::path& path);
+};
@@ -22,8 +22,7 @@
 #include "yolo.h"
 #include "document.h"
 #include "resources.h"
-
-#define THREADS 16
+#include "cpus.h"
 
 typedef enum
 {
@@ -263,33 +262,6 @@ static std::vector<std::filesystem::path> toFilePaths(const std::vector<std::fil
 	return filePaths;
 }
 
-static int popplerEnumToCvFormat(int format)
-{
-	int cvFormat;
-	switch(format)
-	{
-		case poppler::image::format_mono:
-			cvFormat = CV_8UC1;
-			break;
-		case poppler::image::format_rgb24:
-			cvFormat = CV_8UC3;
-			break;
-		case poppler::image::format_argb32:
-			cvFormat = CV_8UC4;
-			break;
-		case poppler::image::format_gray8:
-			cvFormat = CV_8UC1;
-			break;
-		case poppler::image::format_bgr24:
-			cvFormat = CV_8UC3;
-			break;
-		case poppler::image::format_invalid:
-		default:
-			cvFormat = -1;
-	}
-	return cvFormat;
-}
-
 void documentPipeline(const std::vector<std::filesystem::path>& files, size_t stride, size_t offset)
 {
 	poppler::page_renderer renderer;
@@ -371,10 +343,10 @@ static void algoNetsDir(const std::filesystem::path& path)
 static void altAlgoPoppler(const std::filesystem::path& path)
 {
 	std::vector<std::filesystem::path> files = toFilePaths({path});
-	std::vector<std::thread> threads(THREADS);
+	std::vector<std::thread> threads(availableCpus());
 	for(size_t i = 0; i < threads.size(); ++i)
 	{
-		threads[i] = std::thread(documentPipeline, files, THREADS, i);
+		threads[i] = std::thread(documentPipeline, files, threads.size(), i);
 	}
 
 	for(size_t i = 0; i < threads.size(); ++i)
@@ -402,19 +374,20 @@ static void algoPoppler(const std::filesystem::path& path)
 		(void)document->getText();
 	}*/
 
+	const size_t threads = availableCpus();
 	std::vector<std::future<std::shared_ptr<Document>>> futures;
-	futures.reserve(THREADS);
+	futures.reserve(threads);
 
 	for(size_t i = 0; i < files.size();)
 	{
-		while(i < files.size() && futures.size() < THREADS)
+		while(i < files.size() && futures.size() < threads)
 		{
-			futures.push_back(std::async(std::launch::async, Document::load, files[i]));
+			futures.push_back(std::async(std::launch::async, [](const std::filesystem::path& path){return Document::load(path);}, files[i]));
 			Log(Log::INFO)<<"Loading document "<<i<<" of "<< files.size();
 			++i;
 		}
 
-		while(futures.size() >= THREADS)
+		while(futures.size() >= threads)
 		{
 			for(size_t j = 0; j < futures.size(); ++j)
 			{
@@ -424,12 +397,13 @@ static void algoPoppler(const std::filesystem::path& path)
 					futures.erase(futures.begin()+j);
 					if(document)
 					{
-						for(const cv::Mat& mat : document->pages)
+						for(size_t page = 0; page < document->pageCount(); ++page)
 						{
-							if(!mat.u)
+							RenderedPage rendered = document->renderPage(page);
+							if(rendered.image.empty())
 								assert(false);
 							else
-								Log(Log::DEBUG)<<"refcount: "<<mat.u->refcount;
+								Log(Log::DEBUG)<<"page "<<rendered.number<<": "<<rendered.image.cols<<'x'<<rendered.image.rows;
 						}
 					}
 				}
@@ -0,0 +1,82 @@
+#include "triage.h"
+
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+
+//pixels darker than this are ink
+static constexpr double INK_THRESHOLD = 160;
+//pages with less ink outside of text are blank or text only
+static constexpr double MIN_INK = 0.002;
+//pages with fewer line pixels have no drawing a circut could be in
+static constexpr double MIN_LINES = 0.0015;
+//pages with more solid ink are photos
+static constexpr double PHOTO_FILLED = 0.15;
+//minimum length of a line as a fraction of the longer side of the page
+static constexpr int LINE_DIVISOR = 25;
+
+std::string TriageResult::verdictName(Verdict verdict)
+{
+	switch(verdict)
+	{
+		case BLANK:
+			return "blank";
+		case TEXT:
+			return "text";
+		case PHOTO:
+			return "photo";
+		case KEEP:
+		default:
+			return "keep";
+	}
+}
+
+TriageResult triagePage(const cv::Mat& page, const std::vector<cv::Rect>& textBoxes)
+{
+	TriageResult result;
+	//pages that could not be rendered are left to the detectors
+	if(page.empty())
+		return result;
+
+	cv::Mat gray;
+	if(page.channels() == 1)
+		gray = page;
+	else
+		cv::cvtColor(page, gray, cv::COLOR_BGR2GRAY);
+
+	double area = gray.total();
+	cv::Mat ink;
+	cv::threshold(gray, ink, INK_THRESHOLD, 255, cv::THRESH_BINARY_INV);
+
+	//the text layer explains its own ink, labels inside a circut are removed as well but its wires remain
+	cv::Mat textMask = cv::Mat::zeros(gray.size(), CV_8UC1);
+	cv::Rect bounds(0, 0, gray.cols, gray.rows);
+	for(const cv::Rect& box : textBoxes)
+	{
+		cv::Rect clipped = box & bounds;
+		if(clipped.area() > 0)
+			textMask(clipped).setTo(255);
+	}
+	result.textCoverage = cv::countNonZero(textMask)/area;
+	ink.setTo(0, textMask);
+	result.ink = cv::countNonZero(ink)/area;
+
+	//solid areas survive an opening with a square, thin lines do not
+	cv::Mat filled;
+	cv::morphologyEx(ink, filled, cv::MORPH_OPEN, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(5, 5)));
+	result.filled = cv::countNonZero(filled)/area;
+
+	cv::Mat thin;
+	cv::subtract(ink, filled, thin);
+	int length = std::max(std::max(gray.cols, gray.rows)/LINE_DIVISOR, 3);
+	cv::Mat horizontal;
+	cv::Mat vertical;
+	cv::morphologyEx(thin, horizontal, cv::MORPH_OPEN, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(length, 1)));
+	cv::morphologyEx(thin, vertical, cv::MORPH_OPEN, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(1, length)));
+	result.lines = (cv::countNonZero(horizontal) + cv::countNonZero(vertical))/area;
+
+	if(result.ink < MIN_INK)
+		result.verdict = result.textCoverage > 0 ? TriageResult::TEXT : TriageResult::BLANK;
+	else if(result.lines < MIN_LINES)
+		result.verdict = result.filled > PHOTO_FILLED ? TriageResult::PHOTO : TriageResult::TEXT;
+	return result;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+enum TriageMode
+{
+	TRIAGE_OFF = 0,
+	TRIAGE_ON,
+	//pages are judged but still processed, to measure what triage would miss
+	TRIAGE_AUDIT
+};
+
+//cheap judgement whether a page can contain circuts, made before running the detectors on it
+struct TriageResult
+{
+	enum Verdict
+	{
+		KEEP = 0,
+		BLANK,
+		TEXT,
+		PHOTO
+	};
+
+	Verdict verdict = KEEP;
+	//fractions of the page area
+	double textCoverage = 0;
+	//dark pixels outside of the text layer
+	double ink = 0;
+	//ink in solid areas wider than a line
+	double filled = 0;
+	//thin horizontal and vertical lines, circut wires are mostly made of these
+	double lines = 0;
+
+	bool skip() const {return verdict != KEEP;}
+	static std::string verdictName(Verdict verdict);
+};
+
+//pages are judged on a gray render with its longer side at this size
+static constexpr int TRIAGE_LONG_SIDE = 512;
+
+//page is a low resolution render, textBoxes are the boxes of the text layer in pixels of that render
+TriageResult triagePage(const cv::Mat& page, const std::vector<cv::Rect>& textBoxes);
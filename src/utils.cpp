@@ -452,6 +452,26 @@ std::vector<std::string> loadFileLines(const std::filesystem::path& path)
 	return lines;
 }
 
+bool loadFile(const std::filesystem::path& path, std::vector<char>& data)
+{
+	std::fstream file(path, std::fstream::in | std::fstream::binary);
+	if(!file.is_open())
+	{
+		Log(Log::WARN)<<"Could not open file at "<<path;
+		return false;
+	}
+
+	file.seekg(0, std::ios_base::end);
+	std::streamoff size = file.tellg();
+	file.seekg(0, std::ios_base::beg);
+	if(size < 0)
+		return false;
+
+	data.resize(size);
+	file.read(data.data(), size);
+	return !file.fail();
+}
+
 std::string yoloLabelsFromRect(const cv::Rect& rect, const cv::Mat& image, int label)
 {
 	std::stringstream ss;
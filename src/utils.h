@@ -22,6 +22,8 @@ bool isInvalid(const char in);
 
 std::vector<std::string> loadFileLines(const std::filesystem::path& path);
 
+bool loadFile(const std::filesystem::path& path, std::vector<char>& data);
+
 const char* getDirectionString(DirectionHint hint);
 
 bool pointInRect(const cv::Point2i& point, const cv::Rect& rect);
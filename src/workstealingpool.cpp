@@ -0,0 +1,117 @@
+#include "workstealingpool.h"
+
+#include <exception>
+
+#include "log.h"
+
+WorkStealingPool::WorkStealingPool(size_t threadCount, ThreadInit init)
+{
+	if(threadCount == 0)
+		threadCount = 1;
+
+	for(size_t i = 0; i < threadCount; ++i)
+		queues.push_back(std::make_unique<TaskQueue>());
+	for(size_t i = 0; i < threadCount; ++i)
+		threads.push_back(std::thread(&WorkStealingPool::run, this, i, init));
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	stop = true;
+	lock.unlock();
+	wake.notify_all();
+
+	for(std::thread& thread : threads)
+		thread.join();
+}
+
+bool WorkStealingPool::popLocal(size_t index, Task& task)
+{
+	TaskQueue& queue = *queues[index];
+	std::scoped_lock lock(queue.mutex);
+	if(queue.tasks.empty())
+		return false;
+	task = std::move(queue.tasks.front());
+	queue.tasks.pop_front();
+	return true;
+}
+
+bool WorkStealingPool::steal(size_t index, Task& task)
+{
+	for(size_t i = 1; i < queues.size(); ++i)
+	{
+		TaskQueue& queue = *queues[(index+i) % queues.size()];
+		std::scoped_lock lock(queue.mutex);
+		if(queue.tasks.empty())
+			continue;
+		task = std::move(queue.tasks.back());
+		queue.tasks.pop_back();
+		return true;
+	}
+	return false;
+}
+
+void WorkStealingPool::run(size_t index, ThreadInit init)
+{
+	if(init)
+		init(index);
+
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]{return stop || pending > 0;});
+			if(pending == 0)
+				return;
+			--pending;
+		}
+
+		//a task is guaranteed to be queued somewhere as pending was accounted above
+		Task task;
+		while(!popLocal(index, task) && !steal(index, task));
+
+		try
+		{
+			task();
+		}
+		catch(const std::exception& ex)
+		{
+			Log(Log::ERROR)<<"Task failed: "<<ex.what();
+		}
+	}
+}
+
+void WorkStealingPool::submit(std::vector<Task> tasks)
+{
+	if(tasks.empty())
+		return;
+
+	size_t count = tasks.size();
+	TaskQueue& queue = *queues[nextQueue++ % queues.size()];
+	{
+		std::scoped_lock lock(queue.mutex);
+		for(Task& task : tasks)
+			queue.tasks.push_back(std::move(task));
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	pending += count;
+	lock.unlock();
+	if(count == 1)
+		wake.notify_one();
+	else
+		wake.notify_all();
+}
+
+void WorkStealingPool::submit(Task task)
+{
+	std::vector<Task> tasks;
+	tasks.push_back(std::move(task));
+	submit(std::move(tasks));
+}
+
+size_t WorkStealingPool::size() const
+{
+	return threads.size();
+}
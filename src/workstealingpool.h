@@ -0,0 +1,49 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+class WorkStealingPool
+{
+public:
+	typedef std::function<void()> Task;
+	//called on every worker thread before it runs any tasks
+	typedef std::function<void(size_t worker)> ThreadInit;
+
+private:
+	struct TaskQueue
+	{
+		std::deque<Task> tasks;
+		std::mutex mutex;
+	};
+
+	std::vector<std::unique_ptr<TaskQueue>> queues;
+	std::vector<std::thread> threads;
+	std::atomic<size_t> nextQueue = 0;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	size_t pending = 0;
+	bool stop = false;
+
+private:
+	bool popLocal(size_t index, Task& task);
+	bool steal(size_t index, Task& task);
+	void run(size_t index, ThreadInit init);
+
+public:
+	explicit WorkStealingPool(size_t threadCount, ThreadInit init = nullptr);
+	~WorkStealingPool();
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	//all tasks of a batch are queued on the same worker, idle workers steal from the back of other workers queues
+	void submit(std::vector<Task> tasks);
+	void submit(Task task);
+	size_t size() const;
+};
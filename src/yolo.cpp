@@ -68,30 +68,23 @@ cv::Mat Yolo5::prepare(const cv::Mat& mat)
 {
 	cv::Mat inter = resizeWithBorder(mat);
 
-	if(inter.channels() == 1)
-		cv::cvtColor(inter, inter,  cv::COLOR_GRAY2BGR);
-
-	if(inter.type() != CV_32F)
+	if(inter.depth() != CV_32F)
 		inter.convertTo(inter, CV_32F, 1.0/255);
 
-	const int dims[] = {1, inter.channels(), inter.rows, inter.cols};
+	//the network always takes 3 channels, single channel images are only expanded here in the input blob
+	const int dims[] = {1, 3, inter.rows, inter.cols};
 	cv::Mat out(sizeof(dims)/sizeof(*dims), dims, CV_32F);
 
+	std::vector<cv::Mat> splitChannels;
+	if(inter.channels() == 1)
+		splitChannels.assign(3, inter);
+	else
+		cv::split(inter, splitChannels);
 
-	std::vector<cv::Mat> splitChannels(3);
-	cv::split(inter, splitChannels);
-
-	for(int channel = 0; channel < inter.channels(); ++channel)
+	for(int channel = 0; channel < 3; ++channel)
 	{
-		for(int row = 0; row < inter.rows; ++row)
-		{
-			for(int col = 0; col < inter.cols; ++col)
-			{
-				int outIndex = channel*inter.rows*inter.cols+row*inter.cols+col;
-				assert(outIndex < static_cast<int>(out.total()));
-				reinterpret_cast<float*>(out.data)[outIndex] = splitChannels[channel].at<float>(row, col);
-			}
-		}
+		cv::Mat plane(inter.rows, inter.cols, CV_32F, out.ptr<float>() + channel*inter.rows*inter.cols);
+		splitChannels[channel].copyTo(plane);
 	}
 	return out;
 }
@@ -199,6 +192,11 @@ std::vector<Yolo5::DetectedClass> Yolo5::detect(const cv::Mat& image)
 	return detections;
 }
 
+size_t Yolo5::inputBytes() const
+{
+	return static_cast<size_t>(trainSizeX)*trainSizeY*3*sizeof(float);
+}
+
 void Yolo5::drawDetection(cv::Mat& image, const DetectedClass& detection)
 {
 	cv::rectangle(image, detection.rect, cv::Scalar(detection.prob*255,0,255), 2);
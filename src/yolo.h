@@ -37,6 +37,8 @@ public:
 	Yolo5(const std::string& fileName, size_t numClassesI, int trainSizeXIn = 640, int trainSizeYIn = 640);
 	Yolo5(size_t networkDataSize, const char* networkData, size_t numCassesI, int trainSizeXIn = 640, int trainSizeYIn = 640);
 	std::vector<DetectedClass> detect(const cv::Mat& image);
+	//size of the network input blob built for every detection
+	size_t inputBytes() const;
 
 	static void drawDetection(cv::Mat& image, const DetectedClass& detection);
 };
@@ -0,0 +1,124 @@
+#include "yolopool.h"
+
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <exception>
+#include <algorithm>
+
+#include "log.h"
+#include "hash.h"
+
+Yolo5Pool::Lease::Lease(Lease&& in): pool(in.pool), yolo(in.yolo)
+{
+	in.pool = nullptr;
+	in.yolo = nullptr;
+}
+
+Yolo5Pool::Lease::~Lease()
+{
+	if(pool && yolo)
+		pool->checkin(yolo);
+}
+
+Yolo5Pool::Yolo5Pool(size_t networkDataSize, const char* networkData, size_t numClasses, size_t count,
+					 const Placer& placer, int trainSizeX, int trainSizeY)
+{
+	load(networkDataSize, networkData, numClasses, count, placer, trainSizeX, trainSizeY);
+}
+
+Yolo5Pool::Yolo5Pool(const std::filesystem::path& fileName, size_t numClasses, size_t count,
+					 const Placer& placer, int trainSizeX, int trainSizeY)
+{
+	std::ifstream file(fileName, std::ios_base::in | std::ios_base::binary);
+	if(!file.is_open())
+		throw cv::Exception(cv::Error::StsError, "Could not open "+fileName.string(), __func__, __FILE__, __LINE__);
+	std::vector<char> networkData((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	Log(Log::DEBUG)<<"Read "<<networkData.size()<<" bytes of network from "<<fileName;
+	load(networkData.size(), networkData.data(), numClasses, count, placer, trainSizeX, trainSizeY);
+}
+
+void Yolo5Pool::load(size_t networkDataSize, const char* networkData, size_t numClasses, size_t count,
+					 const Placer& placer, int trainSizeX, int trainSizeY)
+{
+	if(count == 0)
+		count = 1;
+
+	networkHash = fnv1a(networkData, networkDataSize);
+	networkHash = fnv1a(&numClasses, sizeof(numClasses), networkHash);
+
+	//every replica gets its own cv::dnn::Net as Net::setInput and Net::forward are not reentrant
+	replicas.resize(count);
+	for(size_t i = 0; i < count; ++i)
+	{
+		Replica& replica = replicas[i];
+		replica.node = -1;
+		if(!placer)
+		{
+			replica.yolo = std::make_unique<Yolo5>(networkDataSize, networkData, numClasses, trainSizeX, trainSizeY);
+			continue;
+		}
+
+		//the replica is created on a thread placed on its node so that its weights are allocated in that nodes memory
+		std::exception_ptr exception;
+		std::thread thread([&]()
+		{
+			try
+			{
+				replica.node = placer(i);
+				replica.yolo = std::make_unique<Yolo5>(networkDataSize, networkData, numClasses, trainSizeX, trainSizeY);
+			}
+			catch(...)
+			{
+				exception = std::current_exception();
+			}
+		});
+		thread.join();
+		if(exception)
+			std::rethrow_exception(exception);
+	}
+
+	for(Replica& replica : replicas)
+		available.push_back(&replica);
+}
+
+Yolo5Pool::Lease Yolo5Pool::checkout(int node)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	returned.wait(lock, [this]{return !available.empty();});
+	std::vector<Replica*>::iterator iterator = available.end()-1;
+	if(node >= 0)
+	{
+		std::vector<Replica*>::iterator local = std::find_if(available.begin(), available.end(), [node](const Replica* replica){return replica->node == node;});
+		if(local != available.end())
+			iterator = local;
+	}
+	Yolo5* yolo = (*iterator)->yolo.get();
+	available.erase(iterator);
+	return Lease(this, yolo);
+}
+
+void Yolo5Pool::checkin(Yolo5* yolo)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for(Replica& replica : replicas)
+	{
+		if(replica.yolo.get() == yolo)
+		{
+			available.push_back(&replica);
+			break;
+		}
+	}
+	lock.unlock();
+	returned.notify_one();
+}
+
+size_t Yolo5Pool::size() const
+{
+	return replicas.size();
+}
+
+uint64_t Yolo5Pool::getNetworkHash() const
+{
+	return networkHash;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <cstdint>
+
+#include "yolo.h"
+
+class Yolo5Pool
+{
+public:
+	//called on the thread a replica is created on before it is created, returns the numa node the replica will live on or -1
+	typedef std::function<int(size_t replica)> Placer;
+
+	class Lease
+	{
+	private:
+		Yolo5Pool* pool;
+		Yolo5* yolo;
+
+	public:
+		Lease(Yolo5Pool* poolI, Yolo5* yoloI): pool(poolI), yolo(yoloI) {}
+		Lease(Lease&& in);
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+		~Lease();
+		Yolo5* get() const {return yolo;}
+		Yolo5* operator->() const {return yolo;}
+	};
+
+private:
+	struct Replica
+	{
+		std::unique_ptr<Yolo5> yolo;
+		int node;
+	};
+
+	std::vector<Replica> replicas;
+	std::vector<Replica*> available;
+	std::mutex mutex;
+	std::condition_variable returned;
+	uint64_t networkHash = 0;
+
+private:
+	void load(size_t networkDataSize, const char* networkData, size_t numClasses, size_t count, const Placer& placer, int trainSizeX, int trainSizeY);
+	void checkin(Yolo5* yolo);
+
+public:
+	Yolo5Pool(size_t networkDataSize, const char* networkData, size_t numClasses, size_t count,
+			  const Placer& placer = nullptr, int trainSizeX = 640, int trainSizeY = 640);
+	Yolo5Pool(const std::filesystem::path& fileName, size_t numClasses, size_t count,
+			  const Placer& placer = nullptr, int trainSizeX = 640, int trainSizeY = 640);
+	Yolo5Pool(const Yolo5Pool&) = delete;
+	Yolo5Pool& operator=(const Yolo5Pool&) = delete;
+
+	//blocks until a replica is free, the replica is returned when the lease is destroyed
+	//a free replica on the given numa node is preferred
+	Lease checkout(int node = -1);
+	size_t size() const;
+	//hash of the network weights and class count, changes whenever a different network is loaded
+	uint64_t getNetworkHash() const;
+};